@@ -0,0 +1,88 @@
+// This example uploads a CSV log written to an SD card while the device was
+// offline, with lines of "timestamp,variable_label,value" and the timestamp
+// in milliseconds. The upload resumes where it stopped after a reboot.
+
+/****************************************
+ * Include Libraries
+ ****************************************/
+
+#include <SD.h>
+
+#include "UbiBackfill.h"
+#include "Ubidots.h"
+
+/****************************************
+ * Define Instances and Constants
+ ****************************************/
+
+const char* UBIDOTS_TOKEN = "...";  // Put here your Ubidots TOKEN
+const char* WIFI_SSID = "...";      // Put here your Wi-Fi SSID
+const char* WIFI_PASS = "...";      // Put here your Wi-Fi password
+const uint8_t SD_CHIP_SELECT = 4;   // Put here the chip select pin of your SD card
+const char* LOG_FILE = "LOG.CSV";
+const char* CHECKPOINT_FILE = "LOG.POS";
+Ubidots ubidots(UBIDOTS_TOKEN, UBI_TCP);
+UbiBackfill backfill(&ubidots);
+File logFile;
+
+/****************************************
+ * Auxiliar Functions
+ ****************************************/
+
+uint32_t readCheckpoint() {
+  uint32_t position = 0;
+  File file = SD.open(CHECKPOINT_FILE, FILE_READ);
+  if (file) {
+    file.read((uint8_t*)&position, sizeof(position));
+    file.close();
+  }
+  return position;
+}
+
+void writeCheckpoint(uint32_t position) {
+  SD.remove(CHECKPOINT_FILE);
+  File file = SD.open(CHECKPOINT_FILE, FILE_WRITE);
+  file.write((const uint8_t*)&position, sizeof(position));
+  file.close();
+}
+
+/****************************************
+ * Main Functions
+ ****************************************/
+
+void setup() {
+  Serial.begin(115200);
+  ubidots.wifiConnect(WIFI_SSID, WIFI_PASS);
+  if (!SD.begin(SD_CHIP_SELECT)) {
+    Serial.println("The SD card could not be read");
+    return;
+  }
+
+  uint32_t position = readCheckpoint();
+  logFile = SD.open(LOG_FILE, FILE_READ);
+  logFile.seek(position);
+  backfill.begin(&logFile, UBI_BACKFILL_CSV, "weather-station", position);  // Change for your device label
+}
+
+void loop() {
+  if (!logFile) {
+    return;
+  }
+
+  uint32_t checkpoint = backfill.checkpoint();
+  if (!backfill.loop()) {
+    logFile.close();
+    writeCheckpoint(backfill.checkpoint());
+    Serial.print("Dots uploaded: ");
+    Serial.print(backfill.acknowledged());
+    Serial.print(", dots/s: ");
+    Serial.println(backfill.dotsPerSecond());
+    if (backfill.failed() > 0) {
+      Serial.println("Some requests failed, reset the board to resume");
+    }
+    return;
+  }
+  if (backfill.checkpoint() != checkpoint) {
+    writeCheckpoint(backfill.checkpoint());
+  }
+}
@@ -15,6 +15,8 @@ const char* UBIDOTS_TOKEN = "...";  // Put here your Ubidots TOKEN
 const char* WIFI_SSID = "...";      // Put here your Wi-Fi SSID
 const char* WIFI_PASS = "...";      // Put here your Wi-Fi password
 Ubidots ubidots(UBIDOTS_TOKEN, UBI_TCP);
+// Referenced by the dots until they are sent, so it outlives loop()
+UbiContext context;
 
 /****************************************
  * Auxiliar Functions
@@ -30,21 +32,15 @@ void setup() {
   Serial.begin(115200);
   ubidots.wifiConnect(WIFI_SSID, WIFI_PASS);
   // ubidots.setDebug(true); // Uncomment this line for printing debug messages
+
+  /* Adds context key-value pairs, keys and values are copied */
+  context.add("weather-status", "sunny");
+  context.add("time", "23h40m56s");  // ":" separates the fields of the TCP payload, add() refuses it
 }
 
 void loop() {
   float value = analogRead(A0);
 
-  /* Adds context key-value pairs */
-  ubidots.addContext("weather-status", "sunny");
-  ubidots.addContext("time", "11:40:56 pm");
-
-  /* Reserves memory to store context array */
-  char* context = (char*)malloc(sizeof(char) * 60);
-
-  /* Builds the context with the array above to send to Ubidots */
-  ubidots.getContext(context);
-
   /* Sends the variable with the context */
   ubidots.add("temperature", value, context);  // Change for your variable name
 
@@ -56,6 +52,5 @@ void loop() {
     Serial.println("Values sent by the device");
   }
 
-  free(context);
   delay(5000);
 }
@@ -16,6 +16,8 @@ const char* WIFI_SSID = "...";      // Put here your Wi-Fi SSID
 const char* WIFI_PASS = "...";      // Put here your Wi-Fi password
 
 Ubidots ubidots(UBIDOTS_TOKEN, UBI_TCP);
+// Referenced by the dots until they are sent, so it outlives loop()
+UbiContext context;
 
 /****************************************
  * Auxiliar Functions
@@ -31,32 +33,18 @@ void setup() {
   Serial.begin(115200);
   ubidots.wifiConnect(WIFI_SSID, WIFI_PASS);
   // ubidots.setDebug(true); //Uncomment this line for printing debug messages
-}
-
-void loop() {
-  float value = random(0, 9) * 10;
 
   /* Hardcoded Coordinates */
   float latitude = 37.773;
   float longitude = -6.2345;
 
-  /* Reserves memory to store context key values, add as much as you need */
-  char* str_lat = (char*)malloc(sizeof(char) * 10);
-  char* str_lng = (char*)malloc(sizeof(char) * 10);
-
-  /* Saves the coordinates as char */
-  sprintf(str_lat, "%f", latitude);
-  sprintf(str_lng, "%f", longitude);
-
-  /* Reserves memory to store context array */
-  char* context = (char*)malloc(sizeof(char) * 30);
-
-  /* Adds context key-value pairs */
-  ubidots.addContext("lat", str_lat);
-  ubidots.addContext("lng", str_lng);
+  /* Adds the coordinates to the context as numbers */
+  context.add("lat", latitude);
+  context.add("lng", longitude);
+}
 
-  /* Builds the context with the coordinates to send to Ubidots */
-  ubidots.getContext(context);
+void loop() {
+  float value = random(0, 9) * 10;
 
   /* Sends the position */
   ubidots.add("position", value, context);  // Change for your variable name
@@ -69,9 +57,5 @@ void loop() {
     Serial.println("Values sent by the device");
   }
 
-  /* free memory */
-  free(str_lat);
-  free(str_lng);
-  free(context);
   delay(5000);
 }
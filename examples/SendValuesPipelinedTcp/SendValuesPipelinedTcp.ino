@@ -0,0 +1,49 @@
+// This example sends several batches of values to the Ubidots API over a
+// single TCP socket without waiting for each answer before the next request.
+
+/****************************************
+ * Include Libraries
+ ****************************************/
+
+#include "Ubidots.h"
+
+/****************************************
+ * Define Instances and Constants
+ ****************************************/
+
+const char* UBIDOTS_TOKEN = "...";  // Put here your Ubidots TOKEN
+const char* WIFI_SSID = "...";      // Put here your Wi-Fi SSID
+const char* WIFI_PASS = "...";      // Put here your Wi-Fi password
+Ubidots ubidots(UBIDOTS_TOKEN, UBI_TCP);
+
+/****************************************
+ * Auxiliar Functions
+ ****************************************/
+
+void onAnswer(uint16_t sequence, bool success, double value) {
+  Serial.print("Request ");
+  Serial.print(sequence);
+  Serial.println(success ? " sent" : " failed");
+}
+
+/****************************************
+ * Main Functions
+ ****************************************/
+
+void setup() {
+  Serial.begin(115200);
+  ubidots.wifiConnect(WIFI_SSID, WIFI_PASS);
+  // ubidots.setDebug(true);  // Uncomment this line for printing debug messages
+}
+
+void loop() {
+  ubidots.beginPipeline(onAnswer);
+
+  for (uint8_t i = 0; i < 10; i++) {
+    ubidots.add("temperature", analogRead(A0));  // Change for your variable name
+    ubidots.send();  // Queues the request, the answer is reported to onAnswer()
+  }
+
+  ubidots.endPipeline();  // Waits for every answer and closes the socket
+  delay(5000);
+}
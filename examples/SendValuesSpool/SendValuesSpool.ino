@@ -0,0 +1,90 @@
+// This example keeps the values in a spool on an SD card, so that they are
+// sent to the Ubidots API once the connection is back, even after a reboot.
+
+/****************************************
+ * Include Libraries
+ ****************************************/
+
+#include <SD.h>
+
+#include "UbiSpool.h"
+#include "Ubidots.h"
+
+/****************************************
+ * Define Instances and Constants
+ ****************************************/
+
+const char* UBIDOTS_TOKEN = "...";  // Put here your Ubidots TOKEN
+const char* WIFI_SSID = "...";      // Put here your Wi-Fi SSID
+const char* WIFI_PASS = "...";      // Put here your Wi-Fi password
+const uint8_t SD_CHIP_SELECT = 4;   // Put here the chip select pin of your SD card
+Ubidots ubidots(UBIDOTS_TOKEN, UBI_HTTP);
+UbiSpool spool(&ubidots);
+
+/****************************************
+ * Auxiliar Functions
+ ****************************************/
+
+// Every segment is a file of the SD card, written in append mode
+class SdStorage : public UbiSpoolStorage {
+public:
+  uint8_t segments() { return 8; }
+  uint32_t segmentSize() { return 32768; }
+
+  bool read(uint8_t segment, uint32_t offset, void* data, uint16_t length) {
+    File file = SD.open(name(segment), FILE_READ);
+    bool ok = file && file.size() >= offset + length && file.seek(offset) &&
+              file.read((uint8_t*)data, length) == length;
+    file.close();
+    return ok;
+  }
+
+  bool write(uint8_t segment, uint32_t offset, const void* data, uint16_t length) {
+    File file = SD.open(name(segment), FILE_WRITE);
+    bool ok = file && file.size() == offset && file.write((const uint8_t*)data, length) == length;
+    file.close();
+    return ok;
+  }
+
+  bool erase(uint8_t segment) {
+    const char* file = name(segment);
+    return !SD.exists(file) || SD.remove(file);
+  }
+
+private:
+  char _name[13];
+
+  const char* name(uint8_t segment) {
+    sprintf(_name, "SPOOL%u.BIN", segment);
+    return _name;
+  }
+};
+
+SdStorage storage;
+
+/****************************************
+ * Main Functions
+ ****************************************/
+
+void setup() {
+  Serial.begin(115200);
+  if (!SD.begin(SD_CHIP_SELECT) || !spool.begin(&storage)) {
+    Serial.println("The spool could not be opened");
+  }
+  ubidots.wifiConnect(WIFI_SSID, WIFI_PASS);
+  // spool.setDebug(true);  // Uncomment this line for printing debug messages
+}
+
+void loop() {
+  // Stamped now, the value keeps its time however late it is sent
+  spool.add("temperature", analogRead(A0));  // Change for your variable name
+
+  // Sends the oldest values first, up to one batch per call
+  if (!spool.replay("weather-station")) {  // Change for your device label
+    Serial.println("Values kept in the spool");
+  }
+
+  Serial.print("Values waiting: ");
+  Serial.println(spool.backlog());
+  delay(5000);
+}
@@ -0,0 +1,77 @@
+// This example subscribes to a variable through MQTT and compares how soon
+// every new value is seen against polling the same variable with get() over
+// TCP. Change the variable from your Ubidots dashboard to see both latencies.
+
+/****************************************
+ * Include Libraries
+ ****************************************/
+
+#include "Ubidots.h"
+
+/****************************************
+ * Define Instances and Constants
+ ****************************************/
+
+const char* UBIDOTS_TOKEN = "...";             // Put here your Ubidots TOKEN
+const char* WIFI_SSID = "...";                 // Put here your Wi-Fi SSID
+const char* WIFI_PASS = "...";                 // Put here your Wi-Fi password
+const char* DEVICE_LABEL = "weather-station";  // Replace with your device label
+const char* VARIABLE_LABEL = "switch";         // Replace with your variable label
+const unsigned long POLLING_INTERVAL = 5000;   // Period of the get() requests in ms
+
+Ubidots ubidotsMqtt(UBIDOTS_TOKEN, UBI_MQTT);
+Ubidots ubidotsTcp(UBIDOTS_TOKEN, UBI_TCP);
+
+double lastValue = ERROR_VALUE;
+unsigned long changedAt = 0;
+bool pushSeen = true;
+bool pollSeen = true;
+unsigned long lastPoll = 0;
+
+/****************************************
+ * Auxiliar Functions
+ ****************************************/
+
+void reportChange(const char* path, double value) {
+  if (value != lastValue) {
+    lastValue = value;
+    changedAt = millis();
+    pushSeen = false;
+    pollSeen = false;
+  }
+  bool* seen = path[0] == 'M' ? &pushSeen : &pollSeen;
+  if (!*seen) {
+    *seen = true;
+    Serial.print(path);
+    Serial.print(" saw ");
+    Serial.print(value);
+    Serial.print(" after ");
+    Serial.print(millis() - changedAt);
+    Serial.println(" ms");
+  }
+}
+
+void onValue(const char* device_label, const char* variable_label, double value) { reportChange("MQTT", value); }
+
+/****************************************
+ * Main Functions
+ ****************************************/
+
+void setup() {
+  Serial.begin(115200);
+  ubidotsMqtt.wifiConnect(WIFI_SSID, WIFI_PASS);
+  // ubidotsMqtt.setDebug(true);  // Uncomment this line for printing debug messages
+  ubidotsMqtt.subscribe(DEVICE_LABEL, VARIABLE_LABEL, onValue);
+}
+
+void loop() {
+  ubidotsMqtt.loop();
+
+  if (millis() - lastPoll > POLLING_INTERVAL) {
+    lastPoll = millis();
+    double value = ubidotsTcp.get(DEVICE_LABEL, VARIABLE_LABEL);
+    if (value != ERROR_VALUE) {
+      reportChange("Polling", value);
+    }
+  }
+}
@@ -0,0 +1,102 @@
+/*
+ * Host benchmark of the gateway scheduler: hundreds of simulated sub-devices,
+ * one of them flooding the gateway, drained by an uplink that sends a few
+ * batches per tick. Prints how the uplink was shared, the queue ages and the
+ * cost of queueing and scheduling.
+ *
+ * g++ -O2 -std=gnu++11 -DUBI_GATEWAY_MAX_DEVICES=400 -I../../src \
+ *     gateway_benchmark.cpp ../../src/UbiGatewayScheduler.cpp -o gateway_benchmark
+ * ./gateway_benchmark
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "UbiGatewayScheduler.h"
+
+namespace {
+
+const uint16_t DEVICES = UBI_GATEWAY_MAX_DEVICES;
+const unsigned long TICKS = 20000;
+const unsigned long TICK_MS = 100;
+// The flooding device queues this many dots per tick, the others one dot every QUIET_PERIOD ticks
+const uint8_t CHATTY_RATE = 20;
+const unsigned long QUIET_PERIOD = 50;
+const uint8_t UPLINK_BATCHES_PER_TICK = 4;
+
+char labels[DEVICES][UBI_GATEWAY_LABEL_SIZE];
+unsigned long maxAge[DEVICES];
+
+} // namespace
+
+int main() {
+  static UbiGatewayScheduler scheduler;
+  for (uint16_t i = 0; i < DEVICES; i++) {
+    snprintf(labels[i], sizeof(labels[i]), "node-%03u", i);
+    scheduler.addDevice(labels[i]);
+  }
+
+  UbiGatewayDot batch[MAX_VALUES];
+  UbiGatewayDot dot = {};
+  dot.value.value_type = UBI_VALUE_FLOAT;
+  unsigned long pushes = 0;
+  unsigned long batches = 0;
+  double pushSeconds = 0;
+  double nextSeconds = 0;
+  srand(1);
+
+  for (unsigned long tick = 0; tick < TICKS; tick++) {
+    unsigned long now = tick * TICK_MS;
+    // Age of the dots left by the uplink on the previous ticks
+    for (uint16_t i = 0; i < DEVICES; i++) {
+      unsigned long age = scheduler.oldestAge(i, now);
+      maxAge[i] = age > maxAge[i] ? age : maxAge[i];
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint8_t i = 0; i < CHATTY_RATE; i++) {
+      dot.variable_label = "temperature";
+      dot.value.dot_value = i;
+      scheduler.push(0, dot, now);
+      pushes++;
+    }
+    for (uint16_t i = 1; i < DEVICES; i++) {
+      if ((tick + i) % QUIET_PERIOD == 0) {
+        dot.variable_label = rand() % 2 ? "temperature" : "humidity";
+        dot.value.dot_value = i;
+        scheduler.push(i, dot, now);
+        pushes++;
+      }
+    }
+    pushSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (uint8_t b = 0; b < UPLINK_BATCHES_PER_TICK; b++) {
+      int16_t device;
+      if (scheduler.next(batch, MAX_VALUES, &device) > 0) {
+        batches++;
+      }
+    }
+    nextSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  uint64_t quietSent = 0;
+  uint64_t quietDropped = 0;
+  unsigned long quietMaxAge = 0;
+  for (uint16_t i = 1; i < DEVICES; i++) {
+    quietSent += scheduler.sent(i);
+    quietDropped += scheduler.dropped(i);
+    quietMaxAge = maxAge[i] > quietMaxAge ? maxAge[i] : quietMaxAge;
+  }
+
+  printf("devices %u, ticks %lu of %lu ms, %u batches of up to %u dots per tick\n", DEVICES, TICKS, TICK_MS,
+         UPLINK_BATCHES_PER_TICK, MAX_VALUES);
+  printf("flooding device: sent %u, dropped %u, max queue age %lu ms\n", scheduler.sent(0), scheduler.dropped(0),
+         maxAge[0]);
+  printf("other devices:   sent %llu, dropped %llu, max queue age %lu ms\n", (unsigned long long)quietSent,
+         (unsigned long long)quietDropped, quietMaxAge);
+  printf("backlog left %u dots\n", scheduler.totalBacklog());
+  printf("push %.0f ns/dot, next %.0f ns/batch\n", pushSeconds * 1e9 / pushes, nextSeconds * 1e9 / batches);
+  return 0;
+}
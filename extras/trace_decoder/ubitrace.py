@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Decodes the binary traces written by Ubidots::setTrace() into a timeline.
+
+Capture the serial port to a file, e.g. with
+    stty -F /dev/ttyACM0 115200 raw && cat /dev/ttyACM0 > trace.bin
+and run
+    python3 ubitrace.py trace.bin
+
+Text printed on the same port is skipped, only the frames are decoded.
+Frame: 0xA5 0x5A, id (1 byte), arg0 (2 bytes), time in us (4 bytes),
+arg1 (4 bytes), little endian. Keep the ids in sync with src/UbiTrace.h.
+"""
+
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+FRAME = struct.Struct("<BHII")
+
+EVENTS = {
+    0: ("DROPPED", lambda a0, a1: "%d events lost, ring full" % a1),
+    1: ("SEND_BEGIN", lambda a0, a1: "%d dots" % a0),
+    2: ("PAYLOAD_BUILT", lambda a0, a1: "%d dots, %d bytes" % (a0, a1)),
+    3: ("SEND_END", lambda a0, a1: "%s, batch %d" % ("ok" if a0 else "failed", a1)),
+    4: ("RETRY", lambda a0, a1: "attempt %d, batch %d" % (a0 + 1, a1)),
+    5: ("REQUEUE", lambda a0, a1: "%d dots kept, %d dropped" % (a0, a1)),
+    6: ("GET_BEGIN", lambda a0, a1: ""),
+    7: ("GET_END", lambda a0, a1: "ok" if a0 else "failed"),
+    8: ("CACHE_HIT", lambda a0, a1: ""),
+    9: ("CONNECT_BEGIN", lambda a0, a1: "port %d" % a0),
+    10: ("CONNECT_END", lambda a0, a1: "connected" if a0 else "failed"),
+    11: ("REQUEST_WRITTEN", lambda a0, a1: "%d bytes in %d transactions" % (a1, a0)),
+    12: ("RESPONSE", lambda a0, a1: "status %d" % a0),
+    13: ("TIMEOUT", lambda a0, a1: "no answer from the server"),
+    14: ("THROTTLED", lambda a0, a1: "%d dots kept, hold %d ms" % (a0, a1)),
+    15: ("TCP_RESPONSE", lambda a0, a1: "ok" if a0 else "failed"),
+}
+
+
+def frames(data):
+    position = data.find(SYNC)
+    while position >= 0 and position + len(SYNC) + FRAME.size <= len(data):
+        start = position + len(SYNC)
+        yield FRAME.unpack_from(data, start)
+        position = data.find(SYNC, start + FRAME.size)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: ubitrace.py <capture file>")
+    with open(sys.argv[1], "rb") as capture:
+        data = capture.read()
+
+    first = previous = None
+    elapsed = 0
+    for event_id, arg0, time, arg1 in frames(data):
+        if first is None:
+            first = previous = time
+        # micros() wraps every 71 minutes
+        delta = (time - previous) & 0xFFFFFFFF
+        elapsed += delta
+        previous = time
+        name, describe = EVENTS.get(event_id, ("UNKNOWN_%d" % event_id, lambda a0, a1: "%d %d" % (a0, a1)))
+        print("%12.3f ms  %+10.3f ms  %-16s %s" % (elapsed / 1000.0, delta / 1000.0, name, describe(arg0, arg1)))
+
+
+if __name__ == "__main__":
+    main()
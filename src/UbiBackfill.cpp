@@ -0,0 +1,338 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiBackfill.h"
+
+UbiBackfill *UbiBackfill::_running = NULL;
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiBackfill::UbiBackfill(Ubidots *ubidots) : _ubidots(ubidots) {}
+
+/**
+ * Starts uploading a log, the instance must use TCP
+ * @arg log [Mandatory] the log file, already seeked to position
+ * @arg format [Mandatory] UBI_BACKFILL_CSV for lines of
+ * "timestamp,variable_label,value" with the timestamp in milliseconds, or
+ * UBI_BACKFILL_BINARY for the records of a spool segment
+ * @arg device_label [Mandatory] device label where the dots will be stored
+ * @arg position [Optional] the checkpoint the upload resumes from
+ * @return false if the pipeline could not be opened
+ */
+
+bool UbiBackfill::begin(Stream *log, UbiBackfillFormat format, const char *device_label, uint32_t position) {
+  if (_running != NULL && _running != this) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] Another backfill is running"));
+    }
+    return false;
+  }
+  _log = log;
+  _format = format;
+  _deviceLabel = device_label;
+  _position = position;
+  _checkpoint = position;
+  _acknowledged = 0;
+  _skipped = 0;
+  _failed = 0;
+  _batchCount = 0;
+  _batchLeft = 0;
+  _batchStart = position;
+  _batchEnd = position;
+  _retryPending = false;
+  _hasNext = false;
+  _framesHead = 0;
+  _framesCount = 0;
+  _running = this;
+  _startedAt = millis();
+  _finishedAt = 0;
+  if (!_ubidots->beginPipeline(_onAnswer)) {
+    _log = NULL;
+    _running = NULL;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Sends the next request, a request that could not be sent is sent again by
+ * the next call
+ * @return false once the whole log was sent and answered
+ */
+
+bool UbiBackfill::loop() {
+  if (_log == NULL) {
+    return false;
+  }
+  if (!_retryPending) {
+    // Dots already in the buffer of the instance go first, the batch takes the free slots
+    uint8_t room = MAX_VALUES - _ubidots->pendingDots();
+    if (room == 0 && UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] The dots buffer of the instance is full, it is sent before the log"));
+    }
+    _batchCount = room > 0 ? _readBatch(room) : 0;
+    if (_batchCount == 0 && _ubidots->pendingDots() == 0) {
+      _finish();
+      return false;
+    }
+    for (uint8_t i = 0; i < _batchCount; i++) {
+      UbiSpool::addTo(_ubidots, _batch[i]);
+    }
+    _batchLeft = _batchCount;
+  }
+
+  // Dots that were not queued or did not fit in the payload stay in the dots
+  // buffer, every queued request gets a frame so that answers match in order
+  bool queued = _ubidots->send(_deviceLabel);
+  uint8_t left = _ubidots->pendingDots();
+  _retryPending = left > 0;
+  uint8_t batchLeft = left < _batchLeft ? left : _batchLeft;
+  if (queued) {
+    Frame *frame = &_frames[(_framesHead + _framesCount) % UBI_PIPELINE_DEPTH];
+    // The checkpoint only moves past the batch with its last request
+    frame->end = batchLeft == 0 ? _batchEnd : _batchStart;
+    frame->dots = _batchLeft - batchLeft;
+    _framesCount++;
+  }
+  _batchLeft = batchLeft;
+  _ubidots->pollPipeline();
+  return true;
+}
+
+/**
+ * Sustained rate of acknowledged dots since begin(), until the end of the log
+ */
+
+float UbiBackfill::dotsPerSecond() const {
+  unsigned long elapsed = (_finishedAt != 0 ? _finishedAt : millis()) - _startedAt;
+  return elapsed > 0 ? _acknowledged * 1000.0f / elapsed : 0;
+}
+
+/**************************************************************************
+ * Private Methods
+ ***************************************************************************/
+
+/**
+ * Moves the checkpoint past the requests acknowledged in order. After a
+ * failed request it stays before it, the upload goes on and the requests
+ * after it are sent again on resume.
+ */
+
+void UbiBackfill::_onAnswer(uint16_t, bool success, double) {
+  UbiBackfill *backfill = _running;
+  if (backfill == NULL || backfill->_framesCount == 0) {
+    return;
+  }
+  Frame *frame = &backfill->_frames[backfill->_framesHead];
+  backfill->_framesHead = (backfill->_framesHead + 1) % UBI_PIPELINE_DEPTH;
+  backfill->_framesCount--;
+  if (!success) {
+    backfill->_failed++;
+    return;
+  }
+  backfill->_acknowledged += frame->dots;
+  if (backfill->_failed == 0) {
+    backfill->_checkpoint = frame->end;
+  }
+}
+
+/**
+ * Packs the next dots of the log into the batch, until max_dots dots or the
+ * payload size is reached
+ * @return number of dots in the batch
+ */
+
+uint8_t UbiBackfill::_readBatch(uint8_t max_dots) {
+  _batchStart = _batchEnd;
+  int16_t budget = MAX_BUFFER_SIZE - UBI_BACKFILL_HEADER_SIZE - 2 * strlen(_deviceLabel);
+  uint32_t nextStart = _position;
+  uint8_t count = 0;
+  while (count < max_dots) {
+    if (!_hasNext) {
+      nextStart = _position;
+      if (!_readRecord(&_next)) {
+        break;
+      }
+      // Lines skipped before the dot are read again on resume, it does not matter
+      _hasNext = true;
+    }
+    int16_t size = strlen(_next.variable_label) + UBI_DOT_PAYLOAD_OVERHEAD;
+    if (count > 0 && size > budget) {
+      break;
+    }
+    budget -= size;
+    _batch[count++] = _next;
+    _hasNext = false;
+  }
+  _batchEnd = _hasNext ? nextStart : _position;
+  return count;
+}
+
+bool UbiBackfill::_readRecord(UbiSpoolRecord *record) {
+  return _format == UBI_BACKFILL_BINARY ? _readBinary(record) : _readCsv(record);
+}
+
+bool UbiBackfill::_readBinary(UbiSpoolRecord *record) {
+  while (_log->readBytes((char *)record, sizeof(UbiSpoolRecord)) == sizeof(UbiSpoolRecord)) {
+    _position += sizeof(UbiSpoolRecord);
+    // Erased space at the end of a segment is not counted
+    if (!UbiSpool::valid(*record)) {
+      _skipped += record->magic == UBI_SPOOL_MAGIC;
+    } else if (record->kind == UBI_SPOOL_DOT) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool UbiBackfill::_readCsv(UbiSpoolRecord *record) {
+  char line[UBI_BACKFILL_LINE_SIZE];
+  uint8_t length = 0;
+  bool truncated = false;
+  int c;
+  while (true) {
+    c = _log->read();
+    if (c >= 0) {
+      _position++;
+    }
+    if (c >= 0 && c != '\n') {
+      if (length < UBI_BACKFILL_LINE_SIZE - 1) {
+        line[length++] = c;
+      } else {
+        truncated = true;
+      }
+      continue;
+    }
+    // End of a line
+    while (length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ')) {
+      length--;
+    }
+    line[length] = '\0';
+    if (length > 0) {
+      if (!truncated && _parseCsvLine(line, record)) {
+        return true;
+      }
+      _skipped++;
+    }
+    if (c < 0) {
+      return false;
+    }
+    length = 0;
+    truncated = false;
+  }
+}
+
+/**
+ * Reads a "timestamp,variable_label,value" line, the header line of the file
+ * is skipped as it has no timestamp
+ */
+
+bool UbiBackfill::_parseCsvLine(char *line, UbiSpoolRecord *record) {
+  char *label = strchr(line, ',');
+  char *value = label != NULL ? strchr(label + 1, ',') : NULL;
+  if (value == NULL || label == line) {
+    return false;
+  }
+  *label++ = '\0';
+  *value++ = '\0';
+  if (value - label - 1 >= UBI_SPOOL_LABEL_SIZE || value - label == 1) {
+    return false;
+  }
+
+  memset(record, 0, sizeof(UbiSpoolRecord));
+  record->kind = UBI_SPOOL_DOT;
+  for (const char *c = line; *c != '\0'; c++) {
+    if (*c < '0' || *c > '9') {
+      return false;
+    }
+    record->timestamp = record->timestamp * 10 + (*c - '0');
+  }
+  if (record->timestamp == 0) {
+    return false;
+  }
+  strcpy(record->variable_label, label);
+  return _parseValue(value, record);
+}
+
+/**
+ * Decimal values are kept as fixed point numbers with the decimals of the
+ * log, so they are sent exactly as they were written
+ */
+
+bool UbiBackfill::_parseValue(const char *text, UbiSpoolRecord *record) {
+  const char *c = text;
+  bool negative = *c == '-';
+  if (*c == '-' || *c == '+') {
+    c++;
+  }
+  uint64_t mantissa = 0;
+  uint8_t digits = 0;
+  uint8_t decimals = 0;
+  bool point = false;
+  for (; *c != '\0'; c++) {
+    if (*c >= '0' && *c <= '9' && digits < 18) {
+      mantissa = mantissa * 10 + (*c - '0');
+      digits++;
+      decimals += point;
+    } else if (*c == '.' && !point) {
+      point = true;
+    } else {
+      break;
+    }
+  }
+
+  if (*c == '\0' && digits > 0) {
+    record->dot_int = negative ? -(int64_t)mantissa : (int64_t)mantissa;
+    record->value_type = decimals > 0 ? UBI_VALUE_FIXED : UBI_VALUE_INT;
+    record->value_scale = decimals;
+    return true;
+  }
+
+  // Exponents and longer numbers
+  char *end;
+  record->dot_double = strtod(text, &end);
+  record->value_type = UBI_VALUE_DOUBLE;
+  return end != text && *end == '\0';
+}
+
+/**
+ * Waits for the answers of the requests in flight and closes the pipeline
+ */
+
+void UbiBackfill::_finish() {
+  _ubidots->endPipeline();
+  _finishedAt = millis();
+  _log = NULL;
+  _running = NULL;
+  if (UBI_LOG_INFO) {
+    Serial.print(F("Backfill done, dots acknowledged: "));
+    Serial.print(_acknowledged);
+    Serial.print(F(", dots/s: "));
+    Serial.print(dotsPerSecond());
+    Serial.print(F(", failed requests: "));
+    Serial.println(_failed);
+  }
+}
@@ -0,0 +1,103 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiBackfill_H_
+#define _UbiBackfill_H_
+
+#include "UbiSpool.h"
+#include "Ubidots.h"
+
+/**
+ * Uploads the dots logged while the device was offline. The log is read as a
+ * stream, each request is packed with as many dots as the payload holds, and
+ * the requests are pipelined on one TCP socket. checkpoint() is the position
+ * of the log up to which every dot was acknowledged, the upload resumes from
+ * there after a reboot or a failed request. Only one backfill runs at a time,
+ * it owns the pipeline of the instance while it runs, dots already in its
+ * dots buffer are sent ahead of the log.
+ */
+
+class UbiBackfill {
+public:
+  explicit UbiBackfill(Ubidots *ubidots);
+  bool begin(Stream *log, UbiBackfillFormat format, const char *device_label, uint32_t position = 0);
+  bool loop();
+  uint32_t checkpoint() const { return _checkpoint; }
+  uint32_t acknowledged() const { return _acknowledged; }
+  uint32_t skipped() const { return _skipped; }
+  uint16_t failed() const { return _failed; }
+  float dotsPerSecond() const;
+  void setDebug(bool debug) { _debug = debug; }
+
+private:
+  typedef struct Frame {
+    uint32_t end;
+    uint8_t dots;
+  } Frame;
+
+  Ubidots *_ubidots;
+  Stream *_log = NULL;
+  UbiBackfillFormat _format = UBI_BACKFILL_CSV;
+  const char *_deviceLabel = NULL;
+  bool _debug = UBI_DEBUG_DEFAULT;
+
+  uint32_t _position = 0;
+  uint32_t _checkpoint = 0;
+  uint32_t _acknowledged = 0;
+  uint32_t _skipped = 0;
+  uint16_t _failed = 0;
+  unsigned long _startedAt = 0;
+  unsigned long _finishedAt = 0;
+
+  // Records of the batch being sent, the dots buffer references their labels
+  UbiSpoolRecord _batch[MAX_VALUES];
+  uint8_t _batchCount = 0;
+  // Dots of the batch not queued yet, they follow the dots already in the buffer
+  uint8_t _batchLeft = 0;
+  uint32_t _batchStart = 0;
+  uint32_t _batchEnd = 0;
+  bool _retryPending = false;
+  // Record read past the end of the last batch, it opens the next one
+  UbiSpoolRecord _next;
+  uint8_t _nextSize = 0;
+  bool _hasNext = false;
+
+  // Requests in flight, answered in the order they were sent
+  Frame _frames[UBI_PIPELINE_DEPTH];
+  uint8_t _framesHead = 0;
+  uint8_t _framesCount = 0;
+
+  static UbiBackfill *_running;
+  static void _onAnswer(uint16_t sequence, bool success, double value);
+
+  uint8_t _readBatch(uint8_t max_dots);
+  bool _readRecord(UbiSpoolRecord *record);
+  bool _readBinary(UbiSpoolRecord *record);
+  bool _readCsv(UbiSpoolRecord *record);
+  bool _parseCsvLine(char *line, UbiSpoolRecord *record);
+  bool _parseValue(const char *text, UbiSpoolRecord *record);
+  void _finish();
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiBufferedClient.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiBufferedClient::UbiBufferedClient(Client *client) : _client(client), _used(0) { resetStats(); }
+
+/**************************************************************************
+ * Print interface
+ ***************************************************************************/
+
+size_t UbiBufferedClient::write(uint8_t c) { return write(&c, 1); }
+
+size_t UbiBufferedClient::write(const uint8_t *buffer, size_t size) {
+  _writes++;
+  size_t written = 0;
+  while (written < size) {
+    // Large writes with an empty buffer go straight to the client
+    if (_used == 0 && size - written >= UBI_WRITE_BUFFER_SIZE) {
+      size_t sent = _clientWrite(buffer + written, size - written);
+      if (sent == 0) {
+        return written;
+      }
+      written += sent;
+      continue;
+    }
+
+    size_t room = UBI_WRITE_BUFFER_SIZE - _used;
+    size_t chunk = size - written < room ? size - written : room;
+    memcpy(_buffer + _used, buffer + written, chunk);
+    _used += chunk;
+    written += chunk;
+
+    if (_used == UBI_WRITE_BUFFER_SIZE) {
+      flush();
+      if (_used != 0) {
+        return written;
+      }
+    }
+  }
+  return written;
+}
+
+/**
+ * Hands the buffered bytes to the client. Call it at every message boundary.
+ * Bytes the client did not take stay buffered, discard() them before the
+ * connection is closed so they do not go in front of the next request.
+ */
+
+void UbiBufferedClient::flush() {
+  if (_used == 0) {
+    return;
+  }
+  size_t sent = _clientWrite(_buffer, _used);
+  if (sent < _used) {
+    memmove(_buffer, _buffer + sent, _used - sent);
+  }
+  _used -= sent;
+}
+
+void UbiBufferedClient::resetStats() {
+  _transactions = 0;
+  _records = 0;
+  _bytes = 0;
+  _writes = 0;
+}
+
+/**************************************************************************
+ * Auxiliar
+ ***************************************************************************/
+
+/**
+ * Every client write is one command to the WiFi module, which encrypts it in
+ * records of up to UBI_TLS_RECORD_SIZE bytes.
+ */
+
+size_t UbiBufferedClient::_clientWrite(const uint8_t *buffer, size_t size) {
+  size_t sent = _client->write(buffer, size);
+  _transactions++;
+  _records += (sent + UBI_TLS_RECORD_SIZE - 1) / UBI_TLS_RECORD_SIZE;
+  _bytes += sent;
+  return sent;
+}
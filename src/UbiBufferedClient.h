@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiBufferedClient_H_
+#define _UbiBufferedClient_H_
+
+#include <Client.h>
+
+#include "UbiConstants.h"
+
+/**
+ * Write-coalescing front end for a Client. Small writes are gathered in a
+ * local buffer and handed to the client in chunks of up to
+ * UBI_WRITE_BUFFER_SIZE bytes, so each message goes out in as few SPI
+ * transactions and TLS records as possible. Call flush() at the end of every
+ * message.
+ */
+
+class UbiBufferedClient : public Print {
+public:
+  explicit UbiBufferedClient(Client *client);
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+  void flush();
+  void discard() { _used = 0; }
+  void setClient(Client *client) {
+    _client = client;
+    _used = 0;
+  }
+  void resetStats();
+  uint32_t transactions() const { return _transactions; }
+  uint32_t records() const { return _records; }
+  uint32_t bytes() const { return _bytes; }
+  uint32_t writes() const { return _writes; }
+
+private:
+  Client *_client;
+  uint8_t _buffer[UBI_WRITE_BUFFER_SIZE];
+  uint16_t _used;
+
+  uint32_t _transactions;
+  uint32_t _records;
+  uint32_t _bytes;
+  uint32_t _writes;
+
+  size_t _clientWrite(const uint8_t *buffer, size_t size);
+};
+
+#endif
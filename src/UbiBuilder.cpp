@@ -25,6 +25,7 @@ Inc
 
 #include "UbiBuilder.h"
 #include "UbiHttp.h"
+#include "UbiMqtt.h"
 #include "UbiTcp.h"
 #include "UbiUdp.h"
 
@@ -33,6 +34,7 @@ UbiBuilder::UbiBuilder(const char *host, const char *token, IotProtocol iot_prot
   command_list[UBI_TCP] = &builderTcp;
   command_list[UBI_HTTP] = &builderHttp;
   command_list[UBI_UDP] = &builderUdp;
+  command_list[UBI_MQTT] = &builderMqtt;
   _host = host;
   _token = token;
 }
@@ -56,3 +58,8 @@ UbiProtocol *builderUdp() {
   UbiProtocol *udpInstance = new UbiUDP(_host, UBIDOTS_TCP_PORT, _token);
   return udpInstance;
 }
+
+UbiProtocol *builderMqtt() {
+  UbiProtocol *mqttInstance = new UbiMQTT(_host, UBIDOTS_MQTTS_PORT, _token);
+  return mqttInstance;
+}
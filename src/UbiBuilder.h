@@ -30,6 +30,7 @@ Inc
 UbiProtocol *builderTcp();
 UbiProtocol *builderHttp();
 UbiProtocol *builderUdp();
+UbiProtocol *builderMqtt();
 
 typedef UbiProtocol *(*builderProtocol)(void);
 
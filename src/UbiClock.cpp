@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiClock.h"
+
+#include <WiFiNINA.h>
+
+namespace {
+const char *const MONTHS = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+long daysFromCivil(int year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  long era = (year >= 0 ? year : year - 399) / 400;
+  unsigned yearOfEra = year - era * 400;
+  unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+} // namespace
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiClock::UbiClock()
+    : _syncedEpoch(0), _syncedAt(0), _anchorEpoch(0), _anchorAt(0), _lastNtpAttempt(0), _ntpSynced(false),
+      _driftPpm(0) {}
+
+/**************************************************************************
+ * Time
+ ***************************************************************************/
+
+/**
+ * @return milliseconds since the epoch, 0 if the clock could not be synced
+ * yet. NTP is asked again every UBI_CLOCK_RESYNC_INTERVAL.
+ */
+
+uint64_t UbiClock::now() {
+  if (!_ntpSynced || millis() - _lastNtpAttempt > UBI_CLOCK_RESYNC_INTERVAL) {
+    // getTime() is answered by the WiFi module from its own NTP client, it is
+    // cheap enough to retry while the module has not got the time
+    if (_lastNtpAttempt == 0 || millis() - _lastNtpAttempt > 1000) {
+      syncFromNtp();
+    }
+  }
+  if (!synced()) {
+    return 0;
+  }
+  return _extrapolate(millis());
+}
+
+bool UbiClock::syncFromNtp() {
+  _lastNtpAttempt = millis();
+  unsigned long epoch = WiFi.getTime();
+  if (epoch == 0) {
+    return false;
+  }
+  _sync((uint64_t)epoch * 1000, millis(), 1000);
+  _ntpSynced = true;
+  return true;
+}
+
+/**
+ * Syncs from an HTTP Date header value, used while NTP is not available
+ * @arg date [Mandatory] date as "Tue, 20 Oct 2020 10:15:00 GMT"
+ */
+
+void UbiClock::syncFromDate(const char *date) {
+  if (_ntpSynced) {
+    return;
+  }
+  unsigned long epoch = parseHttpDate(date);
+  if (epoch != 0) {
+    _sync((uint64_t)epoch * 1000, millis(), 1000);
+  }
+}
+
+/**
+ * @return seconds since the epoch of an IMF-fixdate, 0 if it is malformed
+ */
+
+unsigned long UbiClock::parseHttpDate(const char *date) {
+  const char *comma = strchr(date, ',');
+  if (comma == NULL) {
+    return 0;
+  }
+  char month[4] = {0};
+  int day, year, hour, minute, second;
+  if (sscanf(comma + 1, " %d %3s %d %d:%d:%d", &day, month, &year, &hour, &minute, &second) != 6) {
+    return 0;
+  }
+  const char *found = strstr(MONTHS, month);
+  if (strlen(month) != 3 || found == NULL || (found - MONTHS) % 3 != 0) {
+    return 0;
+  }
+  unsigned monthNumber = (found - MONTHS) / 3 + 1;
+  return daysFromCivil(year, monthNumber, day) * 86400UL + hour * 3600UL + minute * 60UL + second;
+}
+
+/**************************************************************************
+ * Auxiliar
+ ***************************************************************************/
+
+uint64_t UbiClock::_extrapolate(unsigned long at) const {
+  unsigned long elapsed = at - _syncedAt;
+  int64_t correction = (int64_t)elapsed * _driftPpm / 1000000;
+  return _syncedEpoch + elapsed + correction;
+}
+
+/**
+ * Takes a new reference. The drift of millis() is measured against the first
+ * reference, so the one second resolution of the sources is spread over the
+ * whole time since then.
+ */
+
+void UbiClock::_sync(uint64_t epoch, unsigned long at, unsigned long resolution) {
+  if (!synced() || at - _anchorAt > 0x7FFFFFFFUL) {
+    _anchorEpoch = epoch;
+    _anchorAt = at;
+  } else {
+    unsigned long elapsed = at - _anchorAt;
+    if (elapsed >= UBI_CLOCK_MIN_DRIFT_WINDOW) {
+      int64_t error = (int64_t)(epoch - _anchorEpoch) - (int64_t)elapsed;
+      _driftPpm = (int32_t)(error * 1000000 / (int64_t)elapsed);
+    }
+    // A reference consistent with the extrapolated time is not more accurate
+    uint64_t expected = _extrapolate(at);
+    if (epoch < expected + resolution && epoch + resolution > expected) {
+      return;
+    }
+  }
+  _syncedEpoch = epoch;
+  _syncedAt = at;
+}
@@ -0,0 +1,60 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiClock_H_
+#define _UbiClock_H_
+
+#include "UbiConstants.h"
+
+/**
+ * Wall clock in milliseconds since the epoch. It is synced from the WiFi
+ * module NTP client or from the Date header of the server responses, and
+ * extrapolated with millis() in between. The drift of millis() against the
+ * time source is measured on every resync and compensated.
+ */
+
+class UbiClock {
+public:
+  UbiClock();
+  uint64_t now();
+  bool synced() const { return _syncedEpoch != 0; }
+  bool syncFromNtp();
+  void syncFromDate(const char *date);
+  int32_t drift() const { return _driftPpm; }
+  static unsigned long parseHttpDate(const char *date);
+
+private:
+  uint64_t _syncedEpoch;
+  unsigned long _syncedAt;
+  uint64_t _anchorEpoch;
+  unsigned long _anchorAt;
+  unsigned long _lastNtpAttempt;
+  bool _ntpSynced;
+  int32_t _driftPpm;
+
+  uint64_t _extrapolate(unsigned long at) const;
+  void _sync(uint64_t epoch, unsigned long at, unsigned long resolution);
+};
+
+#endif
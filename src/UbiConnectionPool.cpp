@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiConnectionPool.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+/**
+ * @arg max_sockets [Optional] connections open at once, up to
+ * UBI_POOL_MAX_SOCKETS. Keep some sockets free if the sketch opens its own.
+ */
+
+UbiConnectionPool::UbiConnectionPool(uint8_t max_sockets) : _reused(0), _opened(0), _evicted(0) {
+  _maxSockets = max_sockets == 0 || max_sockets > UBI_POOL_MAX_SOCKETS ? UBI_POOL_MAX_SOCKETS : max_sockets;
+  for (uint8_t i = 0; i < UBI_POOL_MAX_SOCKETS; i++) {
+    _connections[i].host = NULL;
+    _connections[i].port = 0;
+    _connections[i].inUse = false;
+    _connections[i].lastUsed = 0;
+  }
+}
+
+/**************************************************************************
+ * Connections
+ ***************************************************************************/
+
+/**
+ * Hands out a connected client for one request
+ * @return NULL if every connection is in use or the server could not be
+ * reached
+ */
+
+WiFiSSLClient *UbiConnectionPool::acquire(const char *host, int port) {
+  for (uint8_t i = 0; i < _maxSockets; i++) {
+    PooledConnection *connection = _connections + i;
+    if (!connection->inUse && connection->host != NULL && connection->port == port &&
+        strcmp(connection->host, host) == 0 && connection->client.connected()) {
+      connection->inUse = true;
+      _reused++;
+      return &connection->client;
+    }
+  }
+
+  PooledConnection *connection = _freeSlot();
+  if (connection == NULL) {
+    return NULL;
+  }
+  connection->host = NULL;
+  if (!connection->client.connectSSL(host, port)) {
+    connection->client.stop();
+    return NULL;
+  }
+  connection->host = host;
+  connection->port = port;
+  connection->inUse = true;
+  _opened++;
+  return &connection->client;
+}
+
+/**
+ * Gives back a client handed out by acquire()
+ * @arg keep_alive [Mandatory] false closes the connection, for protocols
+ * whose server closes it after the answer
+ */
+
+void UbiConnectionPool::release(WiFiSSLClient *client, bool keep_alive) {
+  for (uint8_t i = 0; i < _maxSockets; i++) {
+    PooledConnection *connection = _connections + i;
+    if (&connection->client != client) {
+      continue;
+    }
+    if (!keep_alive) {
+      connection->client.stop();
+      connection->host = NULL;
+    }
+    connection->inUse = false;
+    connection->lastUsed = millis();
+    return;
+  }
+}
+
+uint8_t UbiConnectionPool::openConnections() {
+  uint8_t open = 0;
+  for (uint8_t i = 0; i < _maxSockets; i++) {
+    if (_connections[i].inUse || _connections[i].client.connected()) {
+      open++;
+    }
+  }
+  return open;
+}
+
+/**
+ * Returns a closed slot, closing the least recently used idle connection if
+ * every slot is open
+ */
+
+UbiConnectionPool::PooledConnection *UbiConnectionPool::_freeSlot() {
+  PooledConnection *oldest = NULL;
+  for (uint8_t i = 0; i < _maxSockets; i++) {
+    PooledConnection *connection = _connections + i;
+    if (connection->inUse) {
+      continue;
+    }
+    if (!connection->client.connected()) {
+      return connection;
+    }
+    if (oldest == NULL || millis() - connection->lastUsed > millis() - oldest->lastUsed) {
+      oldest = connection;
+    }
+  }
+  if (oldest != NULL) {
+    oldest->client.stop();
+    oldest->host = NULL;
+    _evicted++;
+  }
+  return oldest;
+}
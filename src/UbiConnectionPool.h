@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiConnectionPool_H_
+#define _UbiConnectionPool_H_
+
+#include <WiFiNINA.h>
+
+#include "UbiConstants.h"
+
+/**
+ * TLS connections shared by several Ubidots instances. A connection to the
+ * same host and port that is not in use is handed out again instead of
+ * opening a new TLS session. Up to UBI_POOL_MAX_SOCKETS connections are open
+ * at once; when a new one is needed the least recently used idle connection
+ * is closed.
+ */
+
+class UbiConnectionPool {
+public:
+  explicit UbiConnectionPool(uint8_t max_sockets = UBI_POOL_MAX_SOCKETS);
+  WiFiSSLClient *acquire(const char *host, int port);
+  void release(WiFiSSLClient *client, bool keep_alive);
+  uint8_t openConnections();
+  uint32_t reused() const { return _reused; }
+  uint32_t opened() const { return _opened; }
+  uint32_t evicted() const { return _evicted; }
+
+private:
+  typedef struct PooledConnection {
+    WiFiSSLClient client;
+    const char *host;
+    int port;
+    bool inUse;
+    unsigned long lastUsed;
+  } PooledConnection;
+
+  PooledConnection _connections[UBI_POOL_MAX_SOCKETS];
+  uint8_t _maxSockets;
+  uint32_t _reused;
+  uint32_t _opened;
+  uint32_t _evicted;
+
+  PooledConnection *_freeSlot();
+};
+
+#endif
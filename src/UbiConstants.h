@@ -29,15 +29,103 @@ Inc
 #include "UbiTypes.h"
 #include "stdint.h"
 
+/**
+ * Dots kept between two send() calls and size of the payload. Define them in
+ * the build flags to batch more dots, e.g. -DUBI_MAX_VALUES=60
+ * -DUBI_MAX_BUFFER_SIZE=2600 to log every second and send every minute.
+ */
+
+#ifndef UBI_MAX_VALUES
+#define UBI_MAX_VALUES 10
+#endif
+
+#ifndef UBI_MAX_BUFFER_SIZE
+#define UBI_MAX_BUFFER_SIZE 700
+#endif
+
+#if UBI_MAX_VALUES < 1 || UBI_MAX_VALUES > 255
+#error "UBI_MAX_VALUES must be between 1 and 255"
+#endif
+
+/**
+ * Requests in flight at once on a TCP pipeline. The answers are small, the
+ * depth is bound by the latency to the server, not by memory.
+ */
+
+#ifndef UBI_MAX_IN_FLIGHT
+#define UBI_MAX_IN_FLIGHT 4
+#endif
+
+#if UBI_MAX_IN_FLIGHT < 1 || UBI_MAX_IN_FLIGHT > 255
+#error "UBI_MAX_IN_FLIGHT must be between 1 and 255"
+#endif
+
+/**
+ * Sub-devices a gateway relays and dots queued per sub-device, the queues take
+ * about 40 bytes per dot
+ */
+
+#ifndef UBI_GATEWAY_MAX_DEVICES
+#define UBI_GATEWAY_MAX_DEVICES 16
+#endif
+
+#ifndef UBI_GATEWAY_QUEUE_SIZE
+#define UBI_GATEWAY_QUEUE_SIZE 8
+#endif
+
 const char UBIDOTS_INDUSTRIAL_IP[] = "169.55.61.243";
 const char *const USER_AGENT = "UbidotsArduinoMKR1000/1.0.0";
 const int UBIDOTS_HTTPS_PORT = 443;
 const int UBIDOTS_TCP_PORT = 9012;
 const int UBIDOTS_TCPS_PORT = 9812;
-const uint8_t MAX_VALUES = 10;
+const int UBIDOTS_MQTTS_PORT = 8883;
+const uint8_t MAX_VALUES = UBI_MAX_VALUES;
 const float ERROR_VALUE = -3.4028235E+8;
-const int MAX_BUFFER_SIZE = 700;
+const int MAX_BUFFER_SIZE = UBI_MAX_BUFFER_SIZE;
 static UbiServer UBI_INDUSTRIAL = "industrial.api.ubidots.com";
-const int NUMBER_OF_SUPPORTED_PROTOCOLS = 3;
+const int NUMBER_OF_SUPPORTED_PROTOCOLS = 4;
+const uint8_t MAX_CONTEXT_KEYS = 10;
+const uint8_t MAX_CONTEXT_POOL_SIZE = 160;
+// Encoded context kept per format, UbiContext::add() refuses the pairs that do not fit
+const uint8_t UBI_CONTEXT_ENCODED_SIZE = 200;
+const uint16_t UBI_WRITE_BUFFER_SIZE = 512;
+const uint16_t UBI_TLS_RECORD_SIZE = 16384;
+const uint8_t UBI_PIPELINE_DEPTH = UBI_MAX_IN_FLIGHT;
+const uint8_t UBI_PIPELINE_RESPONSE_SIZE = 64;
+// Text of a last value read over HTTP, longer bodies are taken as an error
+const uint8_t UBI_LAST_VALUE_SIZE = 32;
+const int UBI_PIPELINE_QUIET_TIME = 50;
+const uint16_t UBI_MQTT_PACKET_SIZE = 160;
+const uint16_t UBI_MQTT_KEEPALIVE = 60;
+const uint8_t UBI_MQTT_MAX_SUBSCRIPTIONS = 5;
+const uint8_t UBI_CACHE_SIZE = 4;
+const uint8_t UBI_CACHE_LABEL_SIZE = 40;
+const uint8_t UBI_MAX_RETRIES = 5;
+const unsigned long UBI_RETRY_BACKOFF = 500;
+const unsigned long UBI_CLOCK_RESYNC_INTERVAL = 3600000;
+const unsigned long UBI_CLOCK_MIN_DRIFT_WINDOW = 21600000;
+const uint8_t NUMBER_OF_PRIORITIES = 3;
+const uint8_t UBI_LATENCY_BUCKETS = 18;
+const uint8_t UBI_DOT_PAYLOAD_OVERHEAD = 40;
+const uint8_t UBI_TRACE_SIZE = 64;
+const uint8_t UBI_TRACE_DRAIN_EVENTS = 8;
+const uint8_t UBI_FAILOVER_MAX_FAILURES = 3;
+const unsigned long UBI_FAILOVER_PROBE_INTERVAL = 30000;
+const unsigned long UBI_FAILOVER_MAX_PROBE_INTERVAL = 600000;
+// Sockets the pool opens at most, the NINA module has a few more for the sketch
+const uint8_t UBI_POOL_MAX_SOCKETS = 4;
+const uint8_t UBI_HISTORY_PAGE_SIZE = 20;
+const uint8_t UBI_HISTORY_CONTEXT_SIZE = 64;
+const uint8_t UBI_HISTORY_NUMBER_SIZE = 24;
+// Longest value written to a payload: a double with 17 digits and its exponent
+const uint8_t UBI_VALUE_STRING_SIZE = 26;
+const uint8_t UBI_MAX_DECIMALS = 18;
+const uint8_t UBI_GATEWAY_LABEL_SIZE = 40;
+// Keeps the spool records 64 bytes long
+const uint8_t UBI_SPOOL_LABEL_SIZE = 38;
+const uint8_t UBI_SPOOL_MAGIC = 0xA5;
+const uint8_t UBI_BACKFILL_LINE_SIZE = 96;
+// Room left in a backfill payload for the user agent, the token and the device
+const uint8_t UBI_BACKFILL_HEADER_SIZE = 128;
 
 #endif
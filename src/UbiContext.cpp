@@ -0,0 +1,287 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiContext.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiContext::UbiContext() { clear(); }
+
+/**************************************************************************
+ * Context key-value pairs
+ ***************************************************************************/
+
+/**
+ * Adds a key-value pair to the context, both strings are copied
+ * @arg key_label [Mandatory] context key label
+ * @arg key_value [Mandatory] context key value
+ * @return false if there is no room left for the pair, if the encoded
+ * context would not fit in UBI_CONTEXT_ENCODED_SIZE, if a string holds a
+ * control character or one of the "$=|:@," separators of the TCP payload, or
+ * if a number is not finite
+ */
+
+bool UbiContext::add(const char *key_label, const char *key_value) {
+  if (_count >= MAX_CONTEXT_KEYS || !_validText(key_value)) {
+    return false;
+  }
+  uint8_t poolUsed = _poolUsed;
+  ContextEntry *entry = &_entries[_count];
+  entry->type = CONTEXT_STRING;
+  if (!_storeKey(entry, key_label) || !_storeText(key_value, &entry->text.offset, &entry->text.length)) {
+    _poolUsed = poolUsed;
+    return false;
+  }
+  return _commit(poolUsed);
+}
+
+bool UbiContext::add(const char *key_label, float key_value) {
+  return _storeReal(key_label, key_value, CONTEXT_FLOAT);
+}
+
+bool UbiContext::add(const char *key_label, double key_value) {
+  return _storeReal(key_label, key_value, CONTEXT_DOUBLE);
+}
+
+bool UbiContext::add(const char *key_label, long key_value) {
+  if (_count >= MAX_CONTEXT_KEYS) {
+    return false;
+  }
+  uint8_t poolUsed = _poolUsed;
+  ContextEntry *entry = &_entries[_count];
+  if (!_storeKey(entry, key_label)) {
+    return false;
+  }
+  entry->type = CONTEXT_LONG;
+  entry->integer = key_value;
+  return _commit(poolUsed);
+}
+
+void UbiContext::clear() {
+  _count = 0;
+  _poolUsed = 0;
+  _invalidate();
+}
+
+/**
+ * Encodes the context in the format expected by the protocol
+ * @arg buffer [Mandatory] char pointer where the context will be written
+ * @arg size [Mandatory] room available in the buffer, including the null
+ * terminator
+ * @arg iot_protocol [Mandatory] UBI_HTTP or UBI_MQTT for JSON, UBI_TCP or
+ * UBI_UDP for the key=value$key=value form
+ * @return number of chars written, 0 if the whole context does not fit. The
+ * pairs are never cut, add() keeps the context within
+ * UBI_CONTEXT_ENCODED_SIZE in both forms.
+ */
+
+size_t UbiContext::encode(char *buffer, size_t size, IotProtocol iot_protocol) const {
+  if (size == 0) {
+    return 0;
+  }
+  bool json = iot_protocol != UBI_TCP && iot_protocol != UBI_UDP;
+  buffer[0] = '\0';
+  if (_encodedSize(_count, json) >= size) {
+    return 0;
+  }
+
+  char *out = buffer;
+  for (uint8_t i = 0; i < _count; i++) {
+    const ContextEntry *entry = &_entries[i];
+    char number[24];
+    uint8_t valueLength;
+    const char *value = _value(entry, number, &valueLength);
+    bool quoted = json && entry->type == CONTEXT_STRING;
+
+    if (i > 0) {
+      *out++ = json ? ',' : '$';
+    }
+    if (json) {
+      *out++ = '"';
+    }
+    out = _copy(out, _pool + entry->key_offset, entry->key_length, json);
+    if (json) {
+      *out++ = '"';
+      *out++ = ':';
+    } else {
+      *out++ = '=';
+    }
+    if (quoted) {
+      *out++ = '"';
+    }
+    out = _copy(out, value, valueLength, quoted);
+    if (quoted) {
+      *out++ = '"';
+    }
+  }
+
+  *out = '\0';
+  return out - buffer;
+}
+
+/**
+ * Encoded context, built once per format and reused until the context is
+ * modified, so a context attached to many dots is not encoded for each of them
+ * @arg iot_protocol [Mandatory] format of the context, see encode()
+ * @arg length [Optional] pointer to store the length of the encoded context
+ */
+
+const char *UbiContext::encoded(IotProtocol iot_protocol, uint8_t *length) const {
+  uint8_t form = _form(iot_protocol);
+  if (!_encodedValid[form]) {
+    _encodedLength[form] = encode(_encoded[form], UBI_CONTEXT_ENCODED_SIZE, iot_protocol);
+    _encodedValid[form] = true;
+  }
+  if (length != NULL) {
+    *length = _encodedLength[form];
+  }
+  return _encoded[form];
+}
+
+/**************************************************************************
+ * Auxiliar
+ ***************************************************************************/
+
+bool UbiContext::_storeReal(const char *key_label, double key_value, ContextType type) {
+  // nan and inf are neither JSON nor numbers the server can store
+  if (_count >= MAX_CONTEXT_KEYS || isnan(key_value) || isinf(key_value)) {
+    return false;
+  }
+  uint8_t poolUsed = _poolUsed;
+  ContextEntry *entry = &_entries[_count];
+  if (!_storeKey(entry, key_label)) {
+    return false;
+  }
+  entry->type = type;
+  entry->real = key_value;
+  return _commit(poolUsed);
+}
+
+bool UbiContext::_storeKey(ContextEntry *entry, const char *key_label) {
+  return _validText(key_label) && _storeText(key_label, &entry->key_offset, &entry->key_length);
+}
+
+/**
+ * Keeps the entry being added if the context still fits in the encoded
+ * buffer in both forms, otherwise gives its text back to the pool
+ */
+
+bool UbiContext::_commit(uint8_t pool_used) {
+  if (_encodedSize(_count + 1, true) >= UBI_CONTEXT_ENCODED_SIZE ||
+      _encodedSize(_count + 1, false) >= UBI_CONTEXT_ENCODED_SIZE) {
+    _poolUsed = pool_used;
+    return false;
+  }
+  _count++;
+  _invalidate();
+  return true;
+}
+
+/**
+ * Length of the first count entries once encoded, without the null terminator
+ */
+
+size_t UbiContext::_encodedSize(uint8_t count, bool json) const {
+  size_t size = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    const ContextEntry *entry = &_entries[i];
+    char number[24];
+    uint8_t valueLength;
+    const char *value = _value(entry, number, &valueLength);
+    bool quoted = json && entry->type == CONTEXT_STRING;
+    // separator + key + ':' or '=' + value, plus quotes for JSON
+    size += (i > 0 ? 1 : 0) + _escapedLength(_pool + entry->key_offset, entry->key_length, json) + 1 +
+            _escapedLength(value, valueLength, quoted) + (json ? 2 : 0) + (quoted ? 2 : 0);
+  }
+  return size;
+}
+
+/**
+ * Value of an entry as text, numbers are printed into number
+ */
+
+const char *UbiContext::_value(const ContextEntry *entry, char *number, uint8_t *length) const {
+  if (entry->type == CONTEXT_STRING) {
+    *length = entry->text.length;
+    return _pool + entry->text.offset;
+  }
+  if (entry->type == CONTEXT_FLOAT) {
+    *length = snprintf(number, 24, "%.7g", entry->real);
+  } else if (entry->type == CONTEXT_DOUBLE) {
+    *length = snprintf(number, 24, "%.15g", entry->real);
+  } else {
+    *length = snprintf(number, 24, "%ld", entry->integer);
+  }
+  return number;
+}
+
+/**
+ * Control characters can not be sent in either form and the TCP payload has
+ * no way to escape its separators, quotes and backslashes are escaped in JSON
+ */
+
+bool UbiContext::_validText(const char *text) {
+  for (const char *c = text; *c != '\0'; c++) {
+    if ((uint8_t)*c < 0x20 || strchr("$=|:@,", *c) != NULL) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t UbiContext::_escapedLength(const char *text, uint8_t length, bool escape) {
+  size_t escaped = length;
+  for (uint8_t i = 0; escape && i < length; i++) {
+    escaped += text[i] == '"' || text[i] == '\\';
+  }
+  return escaped;
+}
+
+char *UbiContext::_copy(char *out, const char *text, uint8_t length, bool escape) {
+  for (uint8_t i = 0; i < length; i++) {
+    if (escape && (text[i] == '"' || text[i] == '\\')) {
+      *out++ = '\\';
+    }
+    *out++ = text[i];
+  }
+  return out;
+}
+
+bool UbiContext::_storeText(const char *text, uint8_t *offset, uint8_t *length) {
+  size_t textLength = strlen(text);
+  if (textLength > (size_t)(MAX_CONTEXT_POOL_SIZE - _poolUsed)) {
+    return false;
+  }
+  memcpy(_pool + _poolUsed, text, textLength);
+  *offset = _poolUsed;
+  *length = textLength;
+  _poolUsed += textLength;
+  return true;
+}
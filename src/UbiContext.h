@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiContext_H_
+#define _UbiContext_H_
+
+#include <stddef.h>
+
+#include "UbiConstants.h"
+
+/**
+ * Dot context owned by the library. Keys and string values are copied into an
+ * internal pool, numbers are kept as numbers, and the context is encoded
+ * once per format, the encoded form is reused by every dot it is attached to
+ * until the context is modified. The same instance can be attached to as many
+ * dots as needed, it is never consumed by send().
+ */
+
+class UbiContext {
+public:
+  UbiContext();
+  bool add(const char *key_label, const char *key_value);
+  bool add(const char *key_label, float key_value);
+  bool add(const char *key_label, double key_value);
+  bool add(const char *key_label, long key_value);
+  bool add(const char *key_label, int key_value) { return add(key_label, (long)key_value); }
+  void clear();
+  uint8_t size() const { return _count; }
+  size_t encode(char *buffer, size_t size, IotProtocol iot_protocol) const;
+  const char *encoded(IotProtocol iot_protocol, uint8_t *length = NULL) const;
+
+private:
+  typedef enum { CONTEXT_STRING, CONTEXT_FLOAT, CONTEXT_DOUBLE, CONTEXT_LONG } ContextType;
+
+  typedef struct ContextEntry {
+    uint8_t key_offset;
+    uint8_t key_length;
+    ContextType type;
+    union {
+      struct {
+        uint8_t offset;
+        uint8_t length;
+      } text;
+      double real;
+      long integer;
+    };
+  } ContextEntry;
+
+  char _pool[MAX_CONTEXT_POOL_SIZE];
+  uint8_t _poolUsed;
+  ContextEntry _entries[MAX_CONTEXT_KEYS];
+  uint8_t _count;
+  // Encoded forms, JSON first then key=value, built on first use
+  mutable char _encoded[2][UBI_CONTEXT_ENCODED_SIZE];
+  mutable uint8_t _encodedLength[2];
+  mutable bool _encodedValid[2];
+
+  bool _storeReal(const char *key_label, double key_value, ContextType type);
+  bool _storeKey(ContextEntry *entry, const char *key_label);
+  bool _storeText(const char *text, uint8_t *offset, uint8_t *length);
+  bool _commit(uint8_t pool_used);
+  size_t _encodedSize(uint8_t count, bool json) const;
+  const char *_value(const ContextEntry *entry, char *number, uint8_t *length) const;
+  static bool _validText(const char *text);
+  static size_t _escapedLength(const char *text, uint8_t length, bool escape);
+  static char *_copy(char *out, const char *text, uint8_t length, bool escape);
+  void _invalidate() { _encodedValid[0] = _encodedValid[1] = false; }
+  static uint8_t _form(IotProtocol iot_protocol) { return iot_protocol == UBI_TCP || iot_protocol == UBI_UDP; }
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiFailover.h"
+
+#include <Arduino.h>
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiFailover::UbiFailover() : _count(0) {}
+
+/**************************************************************************
+ * Scoring
+ ***************************************************************************/
+
+/**
+ * Adds a transport to the candidates. Transports enabled first win the ties,
+ * so the one set in the constructor is preferred while every score is equal.
+ */
+
+void UbiFailover::enable(IotProtocol iot_protocol) {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_order[i] == iot_protocol) {
+      return;
+    }
+  }
+  TransportHealth *health = _health + iot_protocol;
+  health->successRate = 100;
+  health->latency = 0;
+  health->failures = 0;
+  health->down = false;
+  health->downAt = 0;
+  health->probeInterval = UBI_FAILOVER_PROBE_INTERVAL;
+  _order[_count++] = iot_protocol;
+}
+
+/**
+ * Picks the healthiest transport that supports the operation. Down
+ * transports are only picked when every candidate is down.
+ * @arg excluded [Mandatory] bitmask of the transports already tried, bit n
+ * stands for the IotProtocol n
+ * @return false if there is no candidate left
+ */
+
+bool UbiFailover::select(UbiOperation operation, uint8_t excluded, IotProtocol *iot_protocol) const {
+  bool found = false;
+  bool foundDown = true;
+  uint32_t bestScore = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    IotProtocol candidate = _order[i];
+    if ((excluded & (1 << candidate)) || !_supports(candidate, operation)) {
+      continue;
+    }
+    bool down = _health[candidate].down;
+    uint32_t score = _score(candidate);
+    if (!found || (foundDown && !down) || (foundDown == down && score > bestScore)) {
+      *iot_protocol = candidate;
+      bestScore = score;
+      foundDown = down;
+      found = true;
+    }
+  }
+  return found;
+}
+
+/**
+ * Updates the health of a transport after a request or a probe
+ * @arg latency [Mandatory] time in ms the request took
+ */
+
+void UbiFailover::report(IotProtocol iot_protocol, bool success, unsigned long latency) {
+  TransportHealth *health = _health + iot_protocol;
+  health->successRate = (3 * health->successRate + (success ? 100 : 0)) / 4;
+
+  if (success) {
+    health->latency = health->latency == 0 ? latency : (3 * health->latency + latency) / 4;
+    health->failures = 0;
+    health->down = false;
+    health->probeInterval = UBI_FAILOVER_PROBE_INTERVAL;
+    return;
+  }
+
+  if (health->down) {
+    // A failed probe, waits longer for the next one
+    health->downAt = millis();
+    health->probeInterval *= 2;
+    if (health->probeInterval > UBI_FAILOVER_MAX_PROBE_INTERVAL) {
+      health->probeInterval = UBI_FAILOVER_MAX_PROBE_INTERVAL;
+    }
+  } else if (++health->failures >= UBI_FAILOVER_MAX_FAILURES) {
+    health->down = true;
+    health->downAt = millis();
+  }
+}
+
+/**
+ * Tells if a down transport is waiting for a probe
+ */
+
+bool UbiFailover::probeDue(IotProtocol *iot_protocol) const {
+  for (uint8_t i = 0; i < _count; i++) {
+    const TransportHealth *health = _health + _order[i];
+    if (health->down && millis() - health->downAt >= health->probeInterval) {
+      *iot_protocol = _order[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool UbiFailover::_supports(IotProtocol iot_protocol, UbiOperation operation) {
+  if (iot_protocol == UBI_UDP) {
+    // UDP has no answer, it only carries the dots that can be lost
+    return operation == UBI_OPERATION_SEND_UNACKNOWLEDGED;
+  }
+  return true;
+}
+
+/**
+ * Success rate in percent weighted down by the latency: a transport that
+ * answers in one second scores half of an instant one with the same rate
+ */
+
+uint32_t UbiFailover::_score(IotProtocol iot_protocol) const {
+  const TransportHealth *health = _health + iot_protocol;
+  return (uint32_t)health->successRate * 100000UL / (1000UL + health->latency);
+}
@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiFailover_H_
+#define _UbiFailover_H_
+
+#include "UbiConstants.h"
+
+typedef enum { UBI_OPERATION_SEND, UBI_OPERATION_SEND_UNACKNOWLEDGED, UBI_OPERATION_GET } UbiOperation;
+
+/**
+ * Health of the transports enabled for failover. Every transport is scored on
+ * its recent success rate and latency, both moving averages of the last
+ * requests. A transport that fails UBI_FAILOVER_MAX_FAILURES times in a row is
+ * down and only used again once a probe succeeds; probes are spaced from
+ * UBI_FAILOVER_PROBE_INTERVAL up to UBI_FAILOVER_MAX_PROBE_INTERVAL ms.
+ */
+
+class UbiFailover {
+public:
+  UbiFailover();
+  void enable(IotProtocol iot_protocol);
+  bool active() const { return _count > 1; }
+  bool select(UbiOperation operation, uint8_t excluded, IotProtocol *iot_protocol) const;
+  void report(IotProtocol iot_protocol, bool success, unsigned long latency);
+  bool probeDue(IotProtocol *iot_protocol) const;
+  uint8_t successRate(IotProtocol iot_protocol) const { return _health[iot_protocol].successRate; }
+  unsigned long latency(IotProtocol iot_protocol) const { return _health[iot_protocol].latency; }
+  bool down(IotProtocol iot_protocol) const { return _health[iot_protocol].down; }
+
+private:
+  typedef struct TransportHealth {
+    uint8_t successRate;
+    unsigned long latency;
+    uint8_t failures;
+    bool down;
+    unsigned long downAt;
+    unsigned long probeInterval;
+  } TransportHealth;
+
+  TransportHealth _health[NUMBER_OF_SUPPORTED_PROTOCOLS];
+  IotProtocol _order[NUMBER_OF_SUPPORTED_PROTOCOLS];
+  uint8_t _count;
+
+  static bool _supports(IotProtocol iot_protocol, UbiOperation operation);
+  uint32_t _score(IotProtocol iot_protocol) const;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiGateway.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiGateway::UbiGateway(Ubidots *ubidots) : _ubidots(ubidots), _retryDevice(-1) {}
+
+/**************************************************************************
+ * Sub-devices
+ ***************************************************************************/
+
+/**
+ * Registers a sub-device, add() registers the unknown ones too
+ * @arg device_label [Mandatory] label of the sub-device, up to 39 characters
+ * @return false if there is no room for more devices
+ */
+
+bool UbiGateway::addDevice(const char *device_label) { return _scheduler.addDevice(device_label) >= 0; }
+
+/**
+ * Queues a dot of a sub-device
+ * @arg variable_label [Mandatory] the label is referenced, it must be alive
+ * until the dot is sent
+ * @arg dot_timestamp [Optional] milliseconds since the epoch, by default the
+ * dot is stamped now, as it may wait for the other devices
+ * @return false if the device could not be added or its oldest dot was
+ * dropped to make room
+ */
+
+bool UbiGateway::add(const char *device_label, const char *variable_label, float value, uint64_t dot_timestamp) {
+  UbiTypedValue typed;
+  typed.value_type = UBI_VALUE_FLOAT;
+  typed.dot_value = value;
+  return addValue(device_label, variable_label, typed, NULL, dot_timestamp);
+}
+
+/**
+ * Typed dots, sent with all their digits as with Ubidots::addInt(),
+ * addFixed() and addDouble()
+ */
+
+bool UbiGateway::addInt(const char *device_label, const char *variable_label, int64_t value, uint64_t dot_timestamp) {
+  UbiTypedValue typed;
+  typed.value_type = UBI_VALUE_INT;
+  typed.dot_int = value;
+  return addValue(device_label, variable_label, typed, NULL, dot_timestamp);
+}
+
+bool UbiGateway::addFixed(const char *device_label, const char *variable_label, int64_t value, uint8_t decimals,
+                          uint64_t dot_timestamp) {
+  UbiTypedValue typed;
+  typed.value_type = UBI_VALUE_FIXED;
+  typed.value_scale = decimals;
+  typed.dot_int = value;
+  return addValue(device_label, variable_label, typed, NULL, dot_timestamp);
+}
+
+bool UbiGateway::addDouble(const char *device_label, const char *variable_label, double value,
+                           uint64_t dot_timestamp) {
+  UbiTypedValue typed;
+  typed.value_type = UBI_VALUE_DOUBLE;
+  typed.dot_double = value;
+  return addValue(device_label, variable_label, typed, NULL, dot_timestamp);
+}
+
+/**
+ * @arg context [Optional] UbiContext to attach to the dot, it is referenced
+ * and must be alive until the dot is sent
+ */
+
+bool UbiGateway::addValue(const char *device_label, const char *variable_label, const UbiTypedValue &value,
+                          const UbiContext *context, uint64_t dot_timestamp) {
+  int16_t device = _scheduler.addDevice(device_label);
+  if (device < 0) {
+    return false;
+  }
+  UbiGatewayDot dot;
+  dot.variable_label = variable_label;
+  dot.context = context;
+  dot.value = value;
+  dot.timestamp = dot_timestamp != 0 ? dot_timestamp : _ubidots->now();
+  return _scheduler.push(device, dot, millis());
+}
+
+/**
+ * Sends the next batch, the dots left in the buffer by the last one first
+ * @return false if the batch could not be sent
+ */
+
+bool UbiGateway::loop() {
+  int16_t device = _retryDevice;
+  if (device < 0) {
+    uint8_t count = _scheduler.next(_batch, MAX_VALUES, &device);
+    if (count == 0) {
+      return true;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+      _ubidots->addValue(_batch[i].variable_label, _batch[i].value, _batch[i].context, _batch[i].timestamp);
+    }
+  }
+  // The dots of a failed batch, or that did not fit in the payload, stay in
+  // the dots buffer of the instance; rejected dots are not, and once none is
+  // left there is nothing to send again
+  bool sent = _ubidots->send(_scheduler.label(device));
+  _retryDevice = _ubidots->pendingDots() > 0 ? device : -1;
+  return sent;
+}
+
+/**
+ * @arg quantum [Mandatory] payload bytes a device may send per round,
+ * [Default] = 525
+ */
+
+void UbiGateway::setQuantum(uint16_t quantum) { _scheduler.setQuantum(quantum); }
+
+/**************************************************************************
+ * Metrics
+ ***************************************************************************/
+
+uint8_t UbiGateway::backlog(const char *device_label) {
+  int16_t device = _scheduler.find(device_label);
+  return device >= 0 ? _scheduler.backlog(device) : 0;
+}
+
+unsigned long UbiGateway::oldestAge(const char *device_label) {
+  int16_t device = _scheduler.find(device_label);
+  return device >= 0 ? _scheduler.oldestAge(device, millis()) : 0;
+}
+
+uint32_t UbiGateway::dropped(const char *device_label) {
+  int16_t device = _scheduler.find(device_label);
+  return device >= 0 ? _scheduler.dropped(device) : 0;
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiGateway_H_
+#define _UbiGateway_H_
+
+#include "UbiGatewayScheduler.h"
+#include "Ubidots.h"
+
+/**
+ * Relays the dots of sub-devices (LoRa or RS-485 nodes) through the uplink of
+ * an Ubidots instance. Every sub-device has its own bounded queue and loop()
+ * sends one batch per call, taking the devices in deficit round robin order.
+ * The instance must be dedicated to the gateway: it owns the dots buffer, and
+ * dots added to the instance directly would be sent under the label of the
+ * sub-device whose batch is in that buffer.
+ */
+
+class UbiGateway {
+public:
+  explicit UbiGateway(Ubidots *ubidots);
+  bool addDevice(const char *device_label);
+  bool add(const char *device_label, const char *variable_label, float value, uint64_t dot_timestamp = 0);
+  bool addInt(const char *device_label, const char *variable_label, int64_t value, uint64_t dot_timestamp = 0);
+  bool addFixed(const char *device_label, const char *variable_label, int64_t value, uint8_t decimals,
+                uint64_t dot_timestamp = 0);
+  bool addDouble(const char *device_label, const char *variable_label, double value, uint64_t dot_timestamp = 0);
+  bool addValue(const char *device_label, const char *variable_label, const UbiTypedValue &value,
+                const UbiContext *context = NULL, uint64_t dot_timestamp = 0);
+  bool loop();
+  void setQuantum(uint16_t quantum);
+  uint8_t backlog(const char *device_label);
+  unsigned long oldestAge(const char *device_label);
+  uint32_t dropped(const char *device_label);
+  uint32_t totalBacklog() const { return _scheduler.totalBacklog(); }
+  const UbiGatewayScheduler &scheduler() const { return _scheduler; }
+
+private:
+  Ubidots *_ubidots;
+  UbiGatewayScheduler _scheduler;
+  UbiGatewayDot _batch[MAX_VALUES];
+  // Device whose dots are left in the dots buffer, they are sent before any other batch
+  int16_t _retryDevice;
+};
+
+#endif
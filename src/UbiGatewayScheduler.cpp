@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiGatewayScheduler.h"
+
+#include "UbiUtils.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiGatewayScheduler::UbiGatewayScheduler()
+    : _devicesCount(0), _cursor(0), _visited(false), _quantum(MAX_BUFFER_SIZE * 3 / 4), _totalBacklog(0) {}
+
+/**************************************************************************
+ * Devices
+ ***************************************************************************/
+
+/**
+ * @arg device_label [Mandatory] label of the sub-device, copied
+ * @return index of the device, the existing one if it was already added, -1
+ * if there is no room left
+ */
+
+int16_t UbiGatewayScheduler::addDevice(const char *device_label) {
+  int16_t device = find(device_label);
+  if (device >= 0 || _devicesCount >= UBI_GATEWAY_MAX_DEVICES || strlen(device_label) >= UBI_GATEWAY_LABEL_SIZE) {
+    return device;
+  }
+  Device *added = _devices + _devicesCount;
+  strcpy(added->label, device_label);
+  added->labelHash = UbiUtils::fnv1a(device_label);
+  added->head = 0;
+  added->count = 0;
+  added->deficit = 0;
+  added->dropped = 0;
+  added->sent = 0;
+  return _devicesCount++;
+}
+
+int16_t UbiGatewayScheduler::find(const char *device_label) const {
+  uint32_t labelHash = UbiUtils::fnv1a(device_label);
+  for (uint16_t i = 0; i < _devicesCount; i++) {
+    if (_devices[i].labelHash == labelHash && strcmp(_devices[i].label, device_label) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Queues a dot of a device. If its queue is full the oldest dot is dropped,
+ * so a device that floods the gateway only loses its own dots.
+ * @arg now [Mandatory] current time in milliseconds, to measure the age of
+ * the queue
+ * @return false if a dot was dropped
+ */
+
+bool UbiGatewayScheduler::push(int16_t device, const UbiGatewayDot &dot, unsigned long now) {
+  Device *queued = _devices + device;
+  bool room = queued->count < UBI_GATEWAY_QUEUE_SIZE;
+  if (!room) {
+    queued->head = (queued->head + 1) % UBI_GATEWAY_QUEUE_SIZE;
+    queued->count--;
+    queued->dropped++;
+    _totalBacklog--;
+  }
+  UbiGatewayDot *queuedDot = queued->queue + (queued->head + queued->count) % UBI_GATEWAY_QUEUE_SIZE;
+  *queuedDot = dot;
+  queuedDot->added_at = now;
+  queued->count++;
+  _totalBacklog++;
+  return room;
+}
+
+/**************************************************************************
+ * Scheduler
+ ***************************************************************************/
+
+/**
+ * Takes the next batch for the uplink, all its dots belong to one device. The
+ * device in turn gets a quantum of bytes added to its deficit and gives the
+ * dots that fit in it; idle devices do not keep a deficit.
+ * @arg batch [Mandatory] array to store the dots, max_dots long
+ * @arg device [Mandatory] Pointer to store the device of the batch
+ * @return number of dots of the batch, 0 if every queue is empty
+ */
+
+uint8_t UbiGatewayScheduler::next(UbiGatewayDot *batch, uint8_t max_dots, int16_t *device) {
+  while (_totalBacklog > 0) {
+    Device *current = _devices + _cursor;
+    if (current->count == 0) {
+      current->deficit = 0;
+      _advance();
+      continue;
+    }
+    if (!_visited) {
+      _visited = true;
+      uint32_t deficit = (uint32_t)current->deficit + _quantum;
+      current->deficit = deficit < 2 * (uint32_t)_quantum ? deficit : 2 * _quantum;
+    }
+
+    uint8_t taken = 0;
+    while (current->count > 0 && taken < max_dots) {
+      UbiGatewayDot *dot = current->queue + current->head;
+      uint16_t cost = _cost(dot);
+      if (cost > current->deficit) {
+        break;
+      }
+      current->deficit -= cost;
+      batch[taken++] = *dot;
+      current->head = (current->head + 1) % UBI_GATEWAY_QUEUE_SIZE;
+      current->count--;
+    }
+    _totalBacklog -= taken;
+    current->sent += taken;
+    if (current->count == 0) {
+      current->deficit = 0;
+    }
+    // A full batch leaves the device its turn, it goes on with its deficit
+    if (taken == 0 || taken < max_dots || current->count == 0) {
+      _advance();
+    }
+    if (taken > 0) {
+      *device = current - _devices;
+      return taken;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @arg quantum [Mandatory] payload bytes a device may send per round,
+ * [Default] 3/4 of the payload buffer
+ */
+
+void UbiGatewayScheduler::setQuantum(uint16_t quantum) { _quantum = quantum > 0 ? quantum : 1; }
+
+unsigned long UbiGatewayScheduler::oldestAge(int16_t device, unsigned long now) const {
+  const Device *queued = _devices + device;
+  return queued->count > 0 ? now - queued->queue[queued->head].added_at : 0;
+}
+
+/*
+ * Estimated payload bytes of a dot, never above the quantum so that every
+ * device can send at least one dot per round
+ */
+
+uint16_t UbiGatewayScheduler::_cost(const UbiGatewayDot *dot) const {
+  uint16_t cost = strlen(dot->variable_label) + UBI_DOT_PAYLOAD_OVERHEAD;
+  return cost < _quantum ? cost : _quantum;
+}
+
+void UbiGatewayScheduler::_advance() {
+  _cursor = (_cursor + 1) % _devicesCount;
+  _visited = false;
+}
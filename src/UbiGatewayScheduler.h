@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiGatewayScheduler_H_
+#define _UbiGatewayScheduler_H_
+
+#include "UbiConstants.h"
+#include "UbiTypes.h"
+
+typedef struct UbiGatewayDot {
+  const char *variable_label;
+  const UbiContext *context;
+  UbiTypedValue value;
+  uint64_t timestamp;
+  unsigned long added_at;
+} UbiGatewayDot;
+
+/**
+ * Bounded dot queues of the sub-devices of a gateway, drained onto the uplink
+ * in deficit round robin order: every device gets a quantum of payload bytes
+ * per round, so a chatty device can not starve the others. It does not depend
+ * on the board, the caller gives the time.
+ */
+
+class UbiGatewayScheduler {
+public:
+  UbiGatewayScheduler();
+  int16_t addDevice(const char *device_label);
+  int16_t find(const char *device_label) const;
+  bool push(int16_t device, const UbiGatewayDot &dot, unsigned long now);
+  uint8_t next(UbiGatewayDot *batch, uint8_t max_dots, int16_t *device);
+  void setQuantum(uint16_t quantum);
+  uint16_t devices() const { return _devicesCount; }
+  const char *label(int16_t device) const { return _devices[device].label; }
+  uint8_t backlog(int16_t device) const { return _devices[device].count; }
+  uint32_t totalBacklog() const { return _totalBacklog; }
+  unsigned long oldestAge(int16_t device, unsigned long now) const;
+  uint32_t dropped(int16_t device) const { return _devices[device].dropped; }
+  uint32_t sent(int16_t device) const { return _devices[device].sent; }
+
+private:
+  typedef struct Device {
+    char label[UBI_GATEWAY_LABEL_SIZE];
+    uint32_t labelHash;
+    UbiGatewayDot queue[UBI_GATEWAY_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t count;
+    uint16_t deficit;
+    uint32_t dropped;
+    uint32_t sent;
+  } Device;
+
+  Device _devices[UBI_GATEWAY_MAX_DEVICES];
+  uint16_t _devicesCount;
+  uint16_t _cursor;
+  bool _visited;
+  uint16_t _quantum;
+  uint32_t _totalBacklog;
+
+  uint16_t _cost(const UbiGatewayDot *dot) const;
+  void _advance();
+};
+
+#endif
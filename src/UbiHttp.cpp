@@ -26,310 +26,502 @@ Inc
 
 #include "UbiUtils.h"
 
+namespace {
+const char HTTP_PATH_PREFIX[] = "/api/v1.6/devices/";
+const char HTTP_PATH_LV_SUFFIX[] = "/lv";
+const char HTTP_PATH_VALUES_SUFFIX[] = "/values/?page_size=";
+const char HTTP_VERSION[] = " HTTP/1.1\r\n";
+const char HTTP_HOST[] = "Host: ";
+const char HTTP_USER_AGENT[] = "\r\nUser-Agent: ";
+const char HTTP_TOKEN[] = "\r\nX-Auth-Token: ";
+const char HTTP_FIXED_HEADERS[] = "\r\nConnection: close\r\n"
+                                  "Content-Type: application/json\r\n";
+const char HTTP_CONTENT_LENGTH[] = "Content-Length: ";
+const char HTTP_END_OF_HEADERS[] = "\r\n\r\n";
+const char HTTP_END_OF_BODY[] = "\r\n";
+
+/* sizeof() of a char array literal without its null terminator */
+template <size_t N> inline uint16_t literalLength(const char (&)[N]) { return N - 1; }
+
+inline char *append(char *out, const char *source, uint16_t length) {
+  memcpy(out, source, length);
+  return out + length;
+}
+} // namespace
+
 /**************************************************************************
  * Overloaded constructors
  ***************************************************************************/
 
-UbiHTTP::UbiHTTP(const char *host, const int port, const char *token) : UbiProtocol(host, token, port) {}
+UbiHTTP::UbiHTTP(const char *host, const int port, const char *token)
+    : UbiProtocol(host, token, port), _client(&_client_https_ubi), _writer(&_client_https_ubi), _bodyRemaining(-1),
+      _chunked(false), _historyActive(false) {
+  _buildRequestHeaders();
+}
 
 /**************************************************************************
  * Destructor
  ***************************************************************************/
 
 UbiHTTP::~UbiHTTP() {
-  delete[] _host;
-  delete[] _token;
+  free(_requestHeaders);
 }
 
 bool UbiHTTP::sendData(const char *device_label, const char *device_name, char *payload) {
-  /* Connecting the client */
-
-  if (_debug) {
-    Serial.print(F("Connecting to "));
-    Serial.println(_host);
+  if (_historyBusy()) {
+    return false;
   }
-
-  if (!_client_https_ubi.connectSSL(_host, _port)) {
-    if (_debug) {
-      Serial.println(F("Connection Failed to Ubidots - Try Again"));
-    }
-    if (!reconnect<WiFiSSLClient>(&_client_https_ubi)) {
-      return ERROR_VALUE;
-    }
-  }
-
-  if (!_client_https_ubi.connected()) {
-    if (_debug) {
-      Serial.println(F("[ERROR] Could not connect to the server"));
-    }
-    return ERROR_VALUE;
+  /* Connecting the client */
+  if (!connectClient(&_client_https_ubi, &_client)) {
+    return false;
   }
+  _writer.setClient(_client);
 
   bool result = false;
 
   /* Builds the request POST - Please reference this link to know all the
    * request's structures https://ubidots.com/docs/api/ */
 
-  int content_length = strlen(payload);
-
-  uint16_t pathLength = _pathLength(device_label, "");
+  uint16_t contentLength = strlen(payload);
+  uint16_t deviceLabelLength = strlen(device_label);
+  char contentLengthDigits[10];
+  uint8_t contentLengthDigitsLength = UbiUtils::unsignedToChar(contentLengthDigits, contentLength);
 
-  char *path = (char *)malloc(sizeof(char) * pathLength + 1);
+  uint16_t requestLength = literalLength("POST ") + literalLength(HTTP_PATH_PREFIX) + deviceLabelLength +
+                           literalLength(HTTP_VERSION) + _requestHeadersLength + literalLength(HTTP_CONTENT_LENGTH) +
+                           contentLengthDigitsLength + literalLength(HTTP_END_OF_HEADERS) + contentLength +
+                           literalLength(HTTP_END_OF_BODY);
 
-  memset(path, '\0', pathLength);
-
-  sprintf(path, "/api/v1.6/devices/%s", device_label);
-
-  uint16_t requestLength = _buildRequestLength(device_label, payload, pathLength);
-
-  if (_debug) {
+  if (UBI_LOG_DEBUG) {
     Serial.println(F("Making request to Ubidots:\n"));
   }
 
   char *request = (char *)malloc(sizeof(char) * requestLength + 1);
-  sprintf(request,
-          "POST %s HTTP/1.1\r\n"
-          "Host: %s\r\n"
-          "User-Agent: %s\r\n"
-          "X-Auth-Token: %s\r\n"
-          "Connection: close\r\n"
-          "Content-Type: application/json\r\n"
-          "Content-Length: %i\r\n"
-          "\r\n"
-          "%s"
-          "\r\n",
-          path, _host, USER_AGENT, _token, content_length, payload);
-
-  if (_debug) {
+  char *end =
+      _writeRequestLine(request, "POST ", literalLength("POST "), device_label, deviceLabelLength, NULL, 0, NULL, 0);
+  end = append(end, HTTP_CONTENT_LENGTH, literalLength(HTTP_CONTENT_LENGTH));
+  end = append(end, contentLengthDigits, contentLengthDigitsLength);
+  end = append(end, HTTP_END_OF_HEADERS, literalLength(HTTP_END_OF_HEADERS));
+  end = append(end, payload, contentLength);
+  end = append(end, HTTP_END_OF_BODY, literalLength(HTTP_END_OF_BODY));
+  *end = '\0';
+
+  if (UBI_LOG_DEBUG) {
     Serial.println(request);
   }
-  _client_https_ubi.print(request);
+  _writer.resetStats();
+  _writer.write((const uint8_t *)request, requestLength);
+  _writer.flush();
+  _traceEvent(UBI_TRACE_REQUEST_WRITTEN, _writer.transactions(), _writer.bytes());
+  if (UBI_LOG_DEBUG) {
+    printWriterStats(_writer);
+  }
 
-  _client_https_ubi.flush();
+  _client->flush();
 
-  free(path);
   free(request);
 
   /* Reads the response from the server */
+  _scanner.reset();
   if (waitServerAnswer()) {
-    if (_debug) {
+    int status = _readResponseHeaders();
+    if (UBI_LOG_DEBUG) {
       Serial.println(F("\nUbidots' Server response:\n"));
-
-      const char *serverReponse = _client_https_ubi.readString().c_str();
-
-      if (strstr(serverReponse, "400 Bad Request") != NULL || strstr(serverReponse, "Internal Server Error") != NULL) {
+      Serial.print(F("Status: "));
+      Serial.println(status);
+      if (status >= 400) {
         Serial.println(F("[Error] There has been an error in the request"));
-        _client_https_ubi.flush();
-        _client_https_ubi.stop();
-      } else {
-        Serial.println(serverReponse);
       }
     }
+    _scanResponseBody();
 
-    result = true;
+    // Throttled or failed requests are retried, a rejected request only succeeds
+    // when its answer carries the status of every dot
+    result = status != 0 && status != 429 && status < 500 && (status < 400 || _scanner.statuses() > 0);
   } else {
-    if (_debug) {
+    if (UBI_LOG_ERROR) {
       Serial.println(F("Could not read server's response"));
     }
   }
 
-  _client_https_ubi.stop();
+  // The server closes the connection after the answer
+  _writer.discard();
+  disconnectClient(_client, false);
   return result;
 }
 
 /**
- * @brief Calculate the lenght of the request line to be send over HTTP to the
- * server
- *
- * @param device_label label set by the user
- * @param payload  request built by the Library
- * @param pathLength Lengh of the request line
- * @return uint16_t Total length of the request
+ * Requests the last value of a variable and stores the body of the answer, the
+ * value as text, without its surrounding blanks
+ * @arg text [Mandatory] buffer to store the value
+ * @arg size [Mandatory] size of the buffer
+ * @return false if the request failed or the body does not fit
  */
-uint16_t UbiHTTP::_buildRequestLength(const char *device_label, const char *payload, uint16_t pathLength) {
-  uint16_t endpointLength = strlen("POST  HTTP/1.1\r\n"
-                                   "Host: \r\n"
-                                   "User-Agent: \r\n"
-                                   "X-Auth-Token: \r\n"
-                                   "Connection: close\r\n"
-                                   "Content-Type: application/json\r\n"
-                                   "Content-Length: \r\n"
-                                   "\r\n"
-                                   "\r\n") +
-                            pathLength + strlen(device_label) + strlen(_host) + strlen(USER_AGENT) + strlen(_token) +
-                            UbiUtils::countDigit(strlen(payload)) + strlen(payload);
-
-  return endpointLength;
-}
 
-double UbiHTTP::get(const char *device_label, const char *variable_label) {
-  if (_debug) {
-    Serial.print(F("Connecting to "));
-    Serial.println(_host);
+bool UbiHTTP::getText(const char *device_label, const char *variable_label, char *text, size_t size) {
+  if (_historyBusy()) {
+    return false;
   }
-
-  if (!_client_https_ubi.connectSSL(_host, _port)) {
-    if (_debug) {
-      Serial.println(F("Connection Failed to Ubidots - Try Again"));
-    }
-    if (!reconnect<WiFiSSLClient>(&_client_https_ubi)) {
-      return ERROR_VALUE;
-    }
+  if (!connectClient(&_client_https_ubi, &_client)) {
+    return false;
   }
+  _writer.setClient(_client);
 
-  uint16_t pathLength = _pathLength(device_label, variable_label);
-  char *path = (char *)malloc(sizeof(char) * pathLength + 1);
-  sprintf(path, "/api/v1.6/devices/%s/%s/lv", device_label, variable_label);
+  uint16_t deviceLabelLength = strlen(device_label);
+  uint16_t variableLabelLength = strlen(variable_label);
+  uint16_t requestLength = literalLength("GET ") + literalLength(HTTP_PATH_PREFIX) + deviceLabelLength + 1 +
+                           variableLabelLength + literalLength(HTTP_PATH_LV_SUFFIX) + literalLength(HTTP_VERSION) +
+                           _requestHeadersLength + literalLength(HTTP_END_OF_BODY);
 
-  if (_debug) {
-    Serial.print(F("Requesting to URL: "));
-    Serial.println(path);
-  }
-
-  uint16_t requestLineLength = _requestLineLength(path);
-  char *message = (char *)malloc(sizeof(char) * requestLineLength + 1);
-  sprintf(message,
-          "GET %s HTTP/1.1\r\n"
-          "Host: %s\r\n"
-          "X-Auth-Token: %s\r\n"
-          "User-Agent: %s\r\n"
-          "Content-Type: application/json\r\n"
-          "Connection: close\r\n"
-          "\r\n",
-          path, _host, _token, USER_AGENT);
+  char *message = (char *)malloc(sizeof(char) * requestLength + 1);
+  char *end = _writeRequestLine(message, "GET ", literalLength("GET "), device_label, deviceLabelLength, variable_label,
+                                variableLabelLength, HTTP_PATH_LV_SUFFIX, literalLength(HTTP_PATH_LV_SUFFIX));
+  end = append(end, HTTP_END_OF_BODY, literalLength(HTTP_END_OF_BODY));
+  *end = '\0';
 
-  if (_debug) {
+  if (UBI_LOG_DEBUG) {
     Serial.println(F("Request sent"));
     Serial.println(message);
   }
 
-  _client_https_ubi.print(message);
+  _writer.resetStats();
+  _writer.write((const uint8_t *)message, requestLength);
+  _writer.flush();
+  _traceEvent(UBI_TRACE_REQUEST_WRITTEN, _writer.transactions(), _writer.bytes());
+  if (UBI_LOG_DEBUG) {
+    printWriterStats(_writer);
+  }
 
-  while (_client_https_ubi.connected()) {
-    const char *line = _client_https_ubi.readStringUntil('\n').c_str();
-    if (strcmp(line, "\r") == 0) {
-      if (_debug) {
-        Serial.println(F("Headers received"));
+  free(message);
+
+  if (!waitServerAnswer()) {
+    _writer.discard();
+    disconnectClient(_client, false);
+    return false;
+  }
+  int status = _readResponseHeaders();
+  if (status != 200) {
+    if (UBI_LOG_ERROR) {
+      if (status == 404) {
+        Serial.println(F("[ERROR] Either the device or the variable does not exist"));
+      } else {
+        Serial.print(F("[ERROR] Could not read the last value, status: "));
+        Serial.println(status);
       }
-      break;
     }
+    _writer.discard();
+    disconnectClient(_client, false);
+    return false;
   }
 
-  free(message);
-  free(path);
+  size_t length = 0;
+  bool fits = true;
+  int c;
+  while ((c = _readBodyByte()) >= 0) {
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      continue;
+    }
+    if (length < size - 1) {
+      text[length++] = (char)c;
+    } else {
+      fits = false;
+    }
+  }
+  text[length] = '\0';
+  disconnectClient(_client, false);
 
-  double value = _parseServerAnswer();
-  _client_https_ubi.flush();
-  _client_https_ubi.stop();
+  if (UBI_LOG_DEBUG) {
+    Serial.print(F("Value: "));
+    Serial.println(text);
+  }
+  if (!fits || length == 0) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] Unexpected answer to the last value request"));
+    }
+    return false;
+  }
+  return true;
+}
 
-  return value;
+/**
+ * Starts reading the historical values of a variable, newest first. The values
+ * are requested in pages and streamed one at a time by nextValue(), so the
+ * labels must stay valid until the last value is read or endValues() is called.
+ * @arg count [Mandatory] maximum number of values to read, 0 for all of them
+ * @arg start [Mandatory] oldest timestamp in milliseconds, 0 for no limit
+ * @arg end [Mandatory] newest timestamp in milliseconds, 0 for no limit
+ */
+
+bool UbiHTTP::beginValues(const char *device_label, const char *variable_label, uint16_t count, uint64_t start,
+                          uint64_t end) {
+  endValues();
+  _historyDevice = device_label;
+  _historyVariable = variable_label;
+  _historyStart = start;
+  _historyEnd = end;
+  _historyCount = count;
+  _historyYielded = 0;
+  _historyPage = 1;
+  _historyPageSize = count > 0 && count < UBI_HISTORY_PAGE_SIZE ? count : UBI_HISTORY_PAGE_SIZE;
+  _historyActive = _requestValuesPage();
+  return _historyActive;
 }
 
-double UbiHTTP::_parseServerAnswer() {
+/**
+ * @arg value [Mandatory] Pointer to store the next value
+ * @return false once every value was read or the next page could not be
+ * fetched
+ */
 
-  /**
-   * @param _charResponseLength 3 is the maximun amount of digits for the
-   * length to have
-   */
-  char *_charLength = (char *)malloc(sizeof(char) * 3);
+bool UbiHTTP::nextValue(UbiHistoricalValue *value) {
+  while (_historyActive) {
+    int c = _readBodyByte();
+    if (c < 0) {
+      // A page shorter than the page size is the last one
+      disconnectClient(_client, false);
+      _historyActive = false;
+      if (_valuesParser.results() == _historyPageSize) {
+        _historyPage++;
+        _historyActive = _requestValuesPage();
+      }
+      continue;
+    }
+    if (_valuesParser.feed(c)) {
+      *value = _valuesParser.value();
+      _historyYielded++;
+      if (_historyCount > 0 && _historyYielded >= _historyCount) {
+        endValues();
+      }
+      return true;
+    }
+  }
+  return false;
+}
 
-  _parsePartialServerAnswer(_charLength);
+void UbiHTTP::endValues() {
+  if (_historyActive) {
+    disconnectClient(_client, false);
+    _historyActive = false;
+  }
+}
 
-  /**
-   * The server respond the length of the value in HEX so it has to be
-   * converted to DEC
-   * */
-  uint8_t length = UbiUtils::hexadecimalToDecimal(_charLength);
+/**
+ * The values being read stream on the socket other requests would reconnect,
+ * so they fail until endValues() or the last value was read
+ */
 
-  if (_debug) {
-    Serial.print(F("Length: "));
-    Serial.println(length);
+bool UbiHTTP::_historyBusy() {
+  if (_historyActive && UBI_LOG_ERROR) {
+    Serial.println(F("[ERROR] Read every value or call endValues() before another HTTP request"));
   }
+  return _historyActive;
+}
 
-  char *_charValue = (char *)malloc(sizeof(char) * length + 1);
+bool UbiHTTP::_requestValuesPage() {
+  if (!connectClient(&_client_https_ubi, &_client)) {
+    return false;
+  }
+  _writer.setClient(_client);
+
+  char query[literalLength(HTTP_PATH_VALUES_SUFFIX) + 80];
+  char *end = append(query, HTTP_PATH_VALUES_SUFFIX, literalLength(HTTP_PATH_VALUES_SUFFIX));
+  end += UbiUtils::unsignedToChar(end, _historyPageSize);
+  end = append(end, "&page=", 6);
+  end += UbiUtils::unsignedToChar(end, _historyPage);
+  if (_historyStart > 0) {
+    end = append(end, "&start=", 7);
+    end += UbiUtils::unsignedToChar(end, _historyStart);
+  }
+  if (_historyEnd > 0) {
+    end = append(end, "&end=", 5);
+    end += UbiUtils::unsignedToChar(end, _historyEnd);
+  }
+  uint16_t queryLength = end - query;
 
-  _parsePartialServerAnswer(_charValue);
+  uint16_t deviceLabelLength = strlen(_historyDevice);
+  uint16_t variableLabelLength = strlen(_historyVariable);
+  uint16_t requestLength = literalLength("GET ") + literalLength(HTTP_PATH_PREFIX) + deviceLabelLength + 1 +
+                           variableLabelLength + queryLength + literalLength(HTTP_VERSION) + _requestHeadersLength +
+                           literalLength(HTTP_END_OF_BODY);
 
-  double value = strtof(_charValue, NULL);
+  char *message = (char *)malloc(sizeof(char) * requestLength + 1);
+  end = _writeRequestLine(message, "GET ", literalLength("GET "), _historyDevice, deviceLabelLength, _historyVariable,
+                          variableLabelLength, query, queryLength);
+  end = append(end, HTTP_END_OF_BODY, literalLength(HTTP_END_OF_BODY));
+  *end = '\0';
 
-  if (_debug) {
-    Serial.print("Value: ");
-    Serial.println(value);
+  if (UBI_LOG_DEBUG) {
+    Serial.println(message);
   }
+  _writer.resetStats();
+  _writer.write((const uint8_t *)message, requestLength);
+  _writer.flush();
+  _traceEvent(UBI_TRACE_REQUEST_WRITTEN, _writer.transactions(), _writer.bytes());
+  free(message);
 
-  free(_charLength);
-  free(_charValue);
-
-  return value;
+  int status = waitServerAnswer() ? _readResponseHeaders() : 0;
+  if (status != 200) {
+    if (UBI_LOG_ERROR) {
+      Serial.print(F("ERROR reading the values of the variable, status: "));
+      Serial.println(status);
+    }
+    _writer.discard();
+    disconnectClient(_client, false);
+    return false;
+  }
+  _valuesParser.reset();
+  return true;
 }
 
 /**
- * @brief Calculate the lenght of the request line to be send over HTTP to the
- * server
- *
- * @param path address of the endpoint to gather the data
- * @return uint16_t  Lenght of the request line
+ * @brief Renders once the headers that do not change between requests: Host,
+ * User-Agent, X-Auth-Token, Connection and Content-Type
  */
-uint16_t UbiHTTP::_requestLineLength(char *path) {
-  uint16_t endpointLength = strlen("GET  HTTP/1.1\r\n"
-                                   "Host: \r\n"
-                                   "X-Auth-Token: \r\n"
-                                   "User-Agent: \r\n"
-                                   "Content-Type: application/json\r\n"
-                                   "Connection: close\r\n"
-                                   "\r\n") +
-                            strlen(path) + strlen(_host) + strlen(_token) + strlen(USER_AGENT);
-  return endpointLength;
+void UbiHTTP::_buildRequestHeaders() {
+  uint16_t hostLength = strlen(_host);
+  uint16_t userAgentLength = strlen(USER_AGENT);
+  uint16_t tokenLength = strlen(_token);
+  _requestHeadersLength = literalLength(HTTP_HOST) + hostLength + literalLength(HTTP_USER_AGENT) + userAgentLength +
+                          literalLength(HTTP_TOKEN) + tokenLength + literalLength(HTTP_FIXED_HEADERS);
+
+  _requestHeaders = (char *)malloc(sizeof(char) * _requestHeadersLength + 1);
+  char *end = append(_requestHeaders, HTTP_HOST, literalLength(HTTP_HOST));
+  end = append(end, _host, hostLength);
+  end = append(end, HTTP_USER_AGENT, literalLength(HTTP_USER_AGENT));
+  end = append(end, USER_AGENT, userAgentLength);
+  end = append(end, HTTP_TOKEN, literalLength(HTTP_TOKEN));
+  end = append(end, _token, tokenLength);
+  end = append(end, HTTP_FIXED_HEADERS, literalLength(HTTP_FIXED_HEADERS));
+  *end = '\0';
 }
 
 /**
- * @brief Calculate the lenght of the path to be send over HTTP to the server
+ * @brief Writes the request line followed by the pre-rendered headers
  *
+ * @param request buffer to write into
+ * @param method method followed by a blank space, "GET " or "POST "
  * @param device_label device label of the device
- * @param variable_label variable label to be updated or fetched
- * @return uint16_t  Lenght of the endpoint path
+ * @param variable_label variable label to fetch, NULL for the device endpoint
+ * @param suffix path after the variable label, as "/lv"
+ * @return char* pointer to the end of the written data
  */
-uint16_t UbiHTTP::_pathLength(const char *device_label, const char *variable_label) {
-  uint16_t endpointLength = strlen("/api/v1.6/devices///lv") + strlen(device_label) + strlen(variable_label);
-  return endpointLength;
+char *UbiHTTP::_writeRequestLine(char *request, const char *method, uint8_t methodLength, const char *device_label,
+                                 uint16_t deviceLabelLength, const char *variable_label, uint16_t variableLabelLength,
+                                 const char *suffix, uint16_t suffixLength) {
+  char *end = append(request, method, methodLength);
+  end = append(end, HTTP_PATH_PREFIX, literalLength(HTTP_PATH_PREFIX));
+  end = append(end, device_label, deviceLabelLength);
+  if (variable_label != NULL) {
+    *end++ = '/';
+    end = append(end, variable_label, variableLabelLength);
+    end = append(end, suffix, suffixLength);
+  }
+  end = append(end, HTTP_VERSION, literalLength(HTTP_VERSION));
+  return append(end, _requestHeaders, _requestHeadersLength);
 }
 
 /**
- * @arg response [Mandatory] Pointer to store the server's answer
+ * Reads the status line and the headers of the response. The Date header is
+ * used to sync the clock.
+ * @return HTTP status code, 0 if the status line could not be read
  */
 
-void UbiHTTP::_parsePartialServerAnswer(char *_serverResponse) {
-  bool _firstChar = true;
-  while (_client_https_ubi.available()) {
-    if (_firstChar) {
-      _firstChar = false;
-      sprintf(_serverResponse, "%c", _client_https_ubi.read());
+int UbiHTTP::_readResponseHeaders() {
+  int status = 0;
+  bool statusLine = true;
+  _bodyRemaining = -1;
+  _chunked = false;
+  _retryAfter = 0;
+  while (_client->connected() || _client->available()) {
+    String line = _client->readStringUntil('\n');
+    const char *text = line.c_str();
+    if (statusLine) {
+      statusLine = false;
+      const char *space = strchr(text, ' ');
+      if (space != NULL) {
+        status = atoi(space + 1);
+      }
+      continue;
     }
-    char *c = (char *)malloc(sizeof(char) * 2);
-    sprintf(c, "%c", _client_https_ubi.read());
-    if (*c == '\r') {
-      // Get the last character -> \n to let the _parsePartialServerAnswer function to run again
-      _client_https_ubi.read();
-      free(c);
+    if (text[0] == '\0' || strcmp(text, "\r") == 0) {
       break;
-    } else {
-      strcat(_serverResponse, c);
+    }
+    if (_clock != NULL && strncmp(text, "Date: ", 6) == 0) {
+      _clock->syncFromDate(text + 6);
+    }
+    if (strncmp(text, "Content-Length: ", 16) == 0) {
+      _bodyRemaining = atol(text + 16);
+    }
+    if (strncmp(text, "Retry-After: ", 13) == 0) {
+      _retryAfter = strtoul(text + 13, NULL, 10) * 1000;
+    }
+    if (strncmp(text, "Transfer-Encoding: chunked", 26) == 0) {
+      _chunked = true;
+      _bodyRemaining = 0;
     }
   }
+  _traceEvent(UBI_TRACE_RESPONSE, status);
+  return status;
+}
+
+/*
+ * Feeds the body of a POST answer to the scanner as it arrives, so the status
+ * of every variable is known without storing the body
+ */
 
-  if (strstr(_serverResponse, "404001") != NULL && strstr(_serverResponse, "{") != NULL) {
-    sprintf(_serverResponse, "%f", ERROR_VALUE);
-    if (_debug) {
-      Serial.println("[ERROR] Either the device or the variable does not exist");
+void UbiHTTP::_scanResponseBody() {
+  int c;
+  while ((c = _readBodyByte()) >= 0) {
+    _scanner.feed(c);
+    if (UBI_LOG_DEBUG) {
+      Serial.print((char)c);
+    }
+  }
+  if (UBI_LOG_DEBUG) {
+    Serial.println();
+  }
+}
+
+/*
+ * Reads the next byte of the body, up to its Content-Length, to the last
+ * chunk of a chunked body or until the server closes the connection.
+ * @return the byte, -1 at the end of the body
+ */
+
+int UbiHTTP::_readBodyByte() {
+  if (_chunked && _bodyRemaining == 0) {
+    // Chunk size line, after the CRLF that ends the previous chunk
+    String line;
+    do {
+      if (!_waitBodyByte()) {
+        return -1;
+      }
+      line = _client->readStringUntil('\n');
+    } while (line.length() == 0 || line.c_str()[0] == '\r');
+    _bodyRemaining = strtol(line.c_str(), NULL, 16);
+    if (_bodyRemaining == 0) {
+      _chunked = false;
+      return -1;
     }
   }
+  if (_bodyRemaining == 0 || !_waitBodyByte()) {
+    return -1;
+  }
+  if (_bodyRemaining > 0) {
+    _bodyRemaining--;
+  }
+  return _client->read();
+}
 
-  if (strstr(_serverResponse, "<html>") != NULL) {
-    sprintf(_serverResponse, "%f", ERROR_VALUE);
-    if (_debug) {
-      Serial.println(F("[ERROR] Internal Server Error"));
+bool UbiHTTP::_waitBodyByte() {
+  unsigned long start = millis();
+  while (!_client->available()) {
+    if (!_client->connected() || millis() - start >= (unsigned long)_timeout) {
+      return false;
     }
+    delay(1);
   }
+  return true;
 }
 
 /**
@@ -340,11 +532,12 @@ void UbiHTTP::_parsePartialServerAnswer(char *_serverResponse) {
 
 bool UbiHTTP::waitServerAnswer() {
   int timeout = 0;
-  while (!_client_https_ubi.available() && timeout < _timeout) {
+  while (!_client->available() && timeout < _timeout) {
     timeout++;
     delay(1);
     if (timeout > _timeout - 1) {
-      if (_debug) {
+      _traceEvent(UBI_TRACE_TIMEOUT);
+      if (UBI_LOG_ERROR) {
         Serial.println(F("timeout, could not read any response from the host"));
       }
       return false;
@@ -357,4 +550,18 @@ bool UbiHTTP::waitServerAnswer() {
  * Checks if the socket is still opened with the Ubidots Server
  */
 
-bool UbiHTTP::serverConnected() { return _client_https_ubi.connected(); }
\ No newline at end of file
+bool UbiHTTP::serverConnected() { return _client_https_ubi.connected(); }
+
+/*
+ * Checks if the server can be reached opening a connection, with a single
+ * attempt
+ */
+
+bool UbiHTTP::probe() {
+  if (_client_https_ubi.connected()) {
+    return true;
+  }
+  bool connected = _client_https_ubi.connectSSL(_host, _port);
+  _client_https_ubi.stop();
+  return connected;
+}
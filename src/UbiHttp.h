@@ -26,25 +26,56 @@ Inc
 #define _UbiHttp_H_
 
 #include "UbiProtocol.h"
+#include "UbiResponseScanner.h"
+#include "UbiValuesParser.h"
 
 class UbiHTTP : public UbiProtocol {
 public:
   UbiHTTP(const char *host, const int port, const char *token);
   bool sendData(const char *device_label, const char *device_name, char *payload);
-  double get(const char *device_label, const char *variable_label);
+  bool getText(const char *device_label, const char *variable_label, char *text, size_t size);
   bool serverConnected();
+  bool probe();
+  int16_t dotStatus(const char *variable_label, uint8_t index) const { return _scanner.status(variable_label, index); }
+  bool hasDotStatuses() const { return _scanner.statuses() > 0; }
+  bool beginValues(const char *device_label, const char *variable_label, uint16_t count, uint64_t start,
+                   uint64_t end);
+  bool nextValue(UbiHistoricalValue *value);
+  void endValues();
   ~UbiHTTP();
 
 private:
   WiFiSSLClient _client_https_ubi;
+  WiFiSSLClient *_client;
+  UbiBufferedClient _writer;
+  char *_requestHeaders;
+  uint16_t _requestHeadersLength;
+  UbiResponseScanner _scanner;
+  // Bytes left of the body or of its current chunk, -1 until the connection is closed
+  long _bodyRemaining;
+  bool _chunked;
+  UbiValuesParser _valuesParser;
+  bool _historyActive;
+  const char *_historyDevice;
+  const char *_historyVariable;
+  uint64_t _historyStart;
+  uint64_t _historyEnd;
+  uint16_t _historyCount;
+  uint16_t _historyYielded;
+  uint16_t _historyPage;
+  uint8_t _historyPageSize;
 
   bool waitServerAnswer();
-  void _parsePartialServerAnswer(char *response);
-
-  double _parseServerAnswer();
-  uint16_t _requestLineLength(char *path);
-  uint16_t _pathLength(const char *device_label, const char *variable_label);
-  uint16_t _buildRequestLength(const char *device_label, const char *payload, uint16_t path);
+  int _readResponseHeaders();
+  void _scanResponseBody();
+  int _readBodyByte();
+  bool _waitBodyByte();
+  bool _requestValuesPage();
+  bool _historyBusy();
+  void _buildRequestHeaders();
+  char *_writeRequestLine(char *request, const char *method, uint8_t methodLength, const char *device_label,
+                          uint16_t deviceLabelLength, const char *variable_label, uint16_t variableLabelLength,
+                          const char *suffix, uint16_t suffixLength);
 };
 
 #endif
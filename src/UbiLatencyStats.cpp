@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiLatencyStats.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiLatencyStats::UbiLatencyStats() { reset(); }
+
+/**************************************************************************
+ * Statistics
+ ***************************************************************************/
+
+void UbiLatencyStats::record(unsigned long latency) {
+  uint8_t bucket = 0;
+  while (bucket < UBI_LATENCY_BUCKETS - 1 && latency >= (1UL << bucket)) {
+    bucket++;
+  }
+  _buckets[bucket]++;
+  _count++;
+  _sum += latency;
+  if (latency > _max) {
+    _max = latency;
+  }
+}
+
+void UbiLatencyStats::reset() {
+  for (uint8_t i = 0; i < UBI_LATENCY_BUCKETS; i++) {
+    _buckets[i] = 0;
+  }
+  _count = 0;
+  _sum = 0;
+  _max = 0;
+}
+
+/**
+ * @arg percentile [Mandatory] 1 to 100
+ * @return upper bound of the bucket where the percentile falls, capped to
+ * the maximum latency recorded
+ */
+
+unsigned long UbiLatencyStats::percentile(uint8_t percentile) const {
+  if (_count == 0) {
+    return 0;
+  }
+  uint32_t target = ((uint64_t)_count * percentile + 99) / 100;
+  uint32_t accumulated = 0;
+  for (uint8_t i = 0; i < UBI_LATENCY_BUCKETS; i++) {
+    accumulated += _buckets[i];
+    if (accumulated >= target) {
+      unsigned long bound = (1UL << i) - 1;
+      return i == UBI_LATENCY_BUCKETS - 1 || bound > _max ? _max : bound;
+    }
+  }
+  return _max;
+}
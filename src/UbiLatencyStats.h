@@ -0,0 +1,53 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiLatencyStats_H_
+#define _UbiLatencyStats_H_
+
+#include "UbiConstants.h"
+
+/**
+ * Histogram of latencies in milliseconds with power of two buckets, so
+ * percentiles can be estimated without storing every sample. Bucket i holds
+ * the latencies below 2^i ms, the last one everything above.
+ */
+
+class UbiLatencyStats {
+public:
+  UbiLatencyStats();
+  void record(unsigned long latency);
+  void reset();
+  uint32_t count() const { return _count; }
+  unsigned long max() const { return _max; }
+  unsigned long average() const { return _count > 0 ? _sum / _count : 0; }
+  unsigned long percentile(uint8_t percentile) const;
+
+private:
+  uint32_t _buckets[UBI_LATENCY_BUCKETS];
+  uint32_t _count;
+  uint64_t _sum;
+  unsigned long _max;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiLog_H_
+#define _UbiLog_H_
+
+/**
+ * Compile time log levels. Traces above UBI_LOG_LEVEL are constant false
+ * conditions, so the compiler removes them with their strings. Define
+ * UBI_LOG_LEVEL in the build flags to change it, e.g.
+ * -DUBI_LOG_LEVEL=UBI_LEVEL_ERROR. The traces left are printed only if
+ * setDebug(true) was called, they read the _debug member of the class.
+ *
+ * Usage: if (UBI_LOG_DEBUG) { Serial.println(F("message")); }
+ */
+
+#define UBI_LEVEL_NONE 0
+#define UBI_LEVEL_ERROR 1
+#define UBI_LEVEL_INFO 2
+#define UBI_LEVEL_DEBUG 3
+
+#ifndef UBI_LOG_LEVEL
+#define UBI_LOG_LEVEL UBI_LEVEL_DEBUG
+#endif
+
+// Traces are off until setDebug(true) is called
+#define UBI_DEBUG_DEFAULT false
+
+#define UBI_LOG_ERROR (UBI_LOG_LEVEL >= UBI_LEVEL_ERROR && _debug)
+#define UBI_LOG_INFO (UBI_LOG_LEVEL >= UBI_LEVEL_INFO && _debug)
+#define UBI_LOG_DEBUG (UBI_LOG_LEVEL >= UBI_LEVEL_DEBUG && _debug)
+
+#endif
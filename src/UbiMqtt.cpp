@@ -0,0 +1,489 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiMqtt.h"
+
+namespace {
+const uint8_t MQTT_CONNECT = 0x10;
+const uint8_t MQTT_CONNACK = 0x20;
+const uint8_t MQTT_PUBLISH = 0x30;
+const uint8_t MQTT_PUBACK = 0x40;
+const uint8_t MQTT_SUBSCRIBE = 0x82;
+const uint8_t MQTT_SUBACK = 0x90;
+const uint8_t MQTT_UNSUBSCRIBE = 0xA2;
+const uint8_t MQTT_UNSUBACK = 0xB0;
+const uint8_t MQTT_PINGREQ = 0xC0;
+const uint8_t MQTT_DISCONNECT = 0xE0;
+
+const uint8_t MQTT_PROTOCOL_LEVEL = 4;
+const uint8_t MQTT_FLAG_USERNAME = 0x80;
+const uint8_t MQTT_FLAG_PASSWORD = 0x40;
+
+const char MQTT_TOPIC_PREFIX[] = "/v1.6/devices/";
+const char MQTT_LV_SUFFIX[] = "/lv";
+const uint16_t MQTT_TOPIC_PREFIX_LENGTH = sizeof(MQTT_TOPIC_PREFIX) - 1;
+const uint16_t MQTT_LV_SUFFIX_LENGTH = sizeof(MQTT_LV_SUFFIX) - 1;
+} // namespace
+
+/**************************************************************************
+ * Overloaded constructors
+ ***************************************************************************/
+
+UbiMQTT::UbiMQTT(const char *host, const int port, const char *token)
+    : UbiProtocol(host, token, port), _writer(&_client_mqtts_ubi) {
+  _clientId[0] = '\0';
+}
+
+/**************************************************************************
+ * Destructor
+ ***************************************************************************/
+
+UbiMQTT::~UbiMQTT() {
+  if (_client_mqtts_ubi.connected()) {
+    _writeHeader(MQTT_DISCONNECT, 0);
+    _writer.flush();
+  }
+  _client_mqtts_ubi.stop();
+}
+
+/**************************************************************************
+ * Cloud Functions
+ ***************************************************************************/
+
+/**
+ * Publishes the dots to the device topic. The session is kept open between
+ * calls. With QoS 1 the function waits for the broker acknowledgement.
+ */
+
+bool UbiMQTT::sendData(const char *device_label, const char *device_name, char *payload) {
+  if (!_connect()) {
+    return false;
+  }
+
+  uint16_t deviceLabelLength = strlen(device_label);
+  uint16_t topicLength = MQTT_TOPIC_PREFIX_LENGTH + deviceLabelLength;
+  uint16_t payloadLength = strlen(payload);
+  uint16_t packetId = _qos > 0 ? _nextPacketId() : 0;
+
+  if (UBI_LOG_DEBUG) {
+    Serial.print(F("Publishing to "));
+    Serial.print(MQTT_TOPIC_PREFIX);
+    Serial.println(device_label);
+    Serial.println(payload);
+  }
+
+  _writer.resetStats();
+  _writeHeader(MQTT_PUBLISH | (_qos << 1), 2 + topicLength + (_qos > 0 ? 2 : 0) + payloadLength);
+  _writer.write(topicLength >> 8);
+  _writer.write(topicLength & 0xFF);
+  _writer.write((const uint8_t *)MQTT_TOPIC_PREFIX, MQTT_TOPIC_PREFIX_LENGTH);
+  _writer.write((const uint8_t *)device_label, deviceLabelLength);
+  if (_qos > 0) {
+    _writer.write(packetId >> 8);
+    _writer.write(packetId & 0xFF);
+  }
+  _writer.write((const uint8_t *)payload, payloadLength);
+  _writer.flush();
+  if (UBI_LOG_DEBUG) {
+    printWriterStats(_writer);
+  }
+
+  if (_qos > 0 && !_waitFor(MQTT_PUBACK, packetId)) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] The broker did not acknowledge the publish"));
+    }
+    _writer.discard();
+    _client_mqtts_ubi.stop();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Retrieves the last value subscribing to the variable /lv topic, the broker
+ * answers right away with the current value.
+ */
+
+bool UbiMQTT::getText(const char *device_label, const char *variable_label, char *text, size_t size) {
+  if (!_connect()) {
+    return false;
+  }
+
+  _pendingDevice = device_label;
+  _pendingVariable = variable_label;
+  _pendingReceived = false;
+
+  if (_subscribeTopic(MQTT_SUBSCRIBE, device_label, variable_label)) {
+    unsigned long start = millis();
+    while (!_pendingReceived && _client_mqtts_ubi.connected() && millis() - start < (unsigned long)_timeout) {
+      if (!_client_mqtts_ubi.available()) {
+        delay(1);
+        continue;
+      }
+      uint8_t header = _readPacket();
+      if ((header & 0xF0) == MQTT_PUBLISH) {
+        _handlePublish(header);
+      }
+    }
+  }
+
+  bool subscribed = false;
+  for (uint8_t i = 0; i < _subscriptionsCount; i++) {
+    if (strcmp(_subscriptions[i].device_label, device_label) == 0 &&
+        strcmp(_subscriptions[i].variable_label, variable_label) == 0) {
+      subscribed = true;
+    }
+  }
+  if (!subscribed) {
+    _subscribeTopic(MQTT_UNSUBSCRIBE, device_label, variable_label);
+  }
+
+  if (!_pendingReceived && UBI_LOG_ERROR) {
+    Serial.println(F("timeout, could not read the last value from the broker"));
+  }
+  _pendingDevice = NULL;
+  _pendingVariable = NULL;
+  if (!_pendingReceived || strlen(_pendingText) >= size) {
+    return false;
+  }
+  strcpy(text, _pendingText);
+  return true;
+}
+
+/**
+ * Subscribes to the variable last value. The callback is called from loop()
+ * every time the variable receives a new dot.
+ * @return false if there is no room for another subscription or the broker
+ * refused it
+ */
+
+bool UbiMQTT::subscribe(const char *device_label, const char *variable_label, UbiSubscribeCallback callback) {
+  if (_subscriptionsCount >= UBI_MQTT_MAX_SUBSCRIPTIONS) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] You are adding more than the maximum of subscriptions"));
+    }
+    return false;
+  }
+  Subscription *subscription = &_subscriptions[_subscriptionsCount++];
+  subscription->device_label = device_label;
+  subscription->variable_label = variable_label;
+  subscription->callback = callback;
+
+  if (!_client_mqtts_ubi.connected()) {
+    // Every subscription is sent once the session is opened
+    return _connect();
+  }
+  return _subscribeTopic(MQTT_SUBSCRIBE, device_label, variable_label);
+}
+
+/**
+ * Keeps the session alive and dispatches the incoming values to the
+ * subscription callbacks. Call it on every loop() iteration of the sketch.
+ * @return false if the session could not be opened
+ */
+
+bool UbiMQTT::loop() {
+  if (!_connect()) {
+    return false;
+  }
+  while (_client_mqtts_ubi.available()) {
+    uint8_t header = _readPacket();
+    if ((header & 0xF0) == MQTT_PUBLISH) {
+      _handlePublish(header);
+    }
+  }
+  if (millis() - _lastOutbound > UBI_MQTT_KEEPALIVE * 500UL) {
+    _writeHeader(MQTT_PINGREQ, 0);
+    _writer.flush();
+  }
+  return true;
+}
+
+/*
+ * Checks if the session is still opened with the Ubidots broker
+ */
+
+bool UbiMQTT::serverConnected() { return _client_mqtts_ubi.connected(); }
+
+/*
+ * Checks if the broker accepts the session, it is kept opened
+ */
+
+bool UbiMQTT::probe() { return _connect(); }
+
+/**************************************************************************
+ * Auxiliar
+ ***************************************************************************/
+
+/**
+ * Opens the session if it is not already opened. The client id is derived
+ * from the MAC address and the clean session flag is not set, so the broker
+ * keeps the subscriptions between reconnections.
+ */
+
+bool UbiMQTT::_connect() {
+  if (_client_mqtts_ubi.connected()) {
+    return true;
+  }
+
+  if (_clientId[0] == '\0') {
+    byte mac[6];
+    WiFi.macAddress(mac);
+    sprintf(_clientId, "%02X%02X%02X%02X%02X%02X", mac[5], mac[4], mac[3], mac[2], mac[1], mac[0]);
+  }
+
+  if (UBI_LOG_INFO) {
+    Serial.print(F("Connecting to "));
+    Serial.print(_host);
+    Serial.print(F(" on Port: "));
+    Serial.println(_port);
+  }
+
+  if (!_client_mqtts_ubi.connectSSL(_host, _port) && !reconnect<WiFiSSLClient>(&_client_mqtts_ubi)) {
+    return false;
+  }
+
+  // Bytes left by the session that dropped belong to none of the new packets
+  _writer.discard();
+  uint16_t clientIdLength = strlen(_clientId);
+  uint16_t tokenLength = strlen(_token);
+  _writeHeader(MQTT_CONNECT, 10 + 2 + clientIdLength + 2 + tokenLength + 2);
+  _writeString("MQTT", 4);
+  _writer.write(MQTT_PROTOCOL_LEVEL);
+  _writer.write(MQTT_FLAG_USERNAME | MQTT_FLAG_PASSWORD);
+  _writer.write(UBI_MQTT_KEEPALIVE >> 8);
+  _writer.write(UBI_MQTT_KEEPALIVE & 0xFF);
+  _writeString(_clientId, clientIdLength);
+  _writeString(_token, tokenLength);
+  _writeString("", 0);
+  _writer.flush();
+
+  if (!_waitFor(MQTT_CONNACK, 0) || _packetLength < 2 || _packet[1] != 0) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] The broker refused the connection"));
+    }
+    _writer.discard();
+    _client_mqtts_ubi.stop();
+    return false;
+  }
+
+  bool sessionPresent = _packet[0] & 0x01;
+  if (!sessionPresent) {
+    for (uint8_t i = 0; i < _subscriptionsCount; i++) {
+      _subscribeTopic(MQTT_SUBSCRIBE, _subscriptions[i].device_label, _subscriptions[i].variable_label);
+    }
+  }
+  return true;
+}
+
+bool UbiMQTT::_subscribeTopic(uint8_t type, const char *device_label, const char *variable_label) {
+  uint16_t packetId = _nextPacketId();
+  uint16_t topicLength =
+      MQTT_TOPIC_PREFIX_LENGTH + strlen(device_label) + 1 + strlen(variable_label) + MQTT_LV_SUFFIX_LENGTH;
+  bool subscribe = type == MQTT_SUBSCRIBE;
+
+  _writeHeader(type, 2 + 2 + topicLength + (subscribe ? 1 : 0));
+  _writer.write(packetId >> 8);
+  _writer.write(packetId & 0xFF);
+  _writeLastValueTopic(device_label, variable_label);
+  if (subscribe) {
+    _writer.write(_qos);
+  }
+  _writer.flush();
+
+  return _waitFor(subscribe ? MQTT_SUBACK : MQTT_UNSUBACK, packetId);
+}
+
+uint16_t UbiMQTT::_nextPacketId() {
+  _packetId++;
+  if (_packetId == 0) {
+    _packetId = 1;
+  }
+  return _packetId;
+}
+
+void UbiMQTT::_writeHeader(uint8_t header, uint32_t remainingLength) {
+  _writer.write(header);
+  do {
+    uint8_t digit = remainingLength % 128;
+    remainingLength /= 128;
+    if (remainingLength > 0) {
+      digit |= 0x80;
+    }
+    _writer.write(digit);
+  } while (remainingLength > 0);
+  _lastOutbound = millis();
+}
+
+void UbiMQTT::_writeString(const char *text, uint16_t length) {
+  _writer.write(length >> 8);
+  _writer.write(length & 0xFF);
+  _writer.write((const uint8_t *)text, length);
+}
+
+void UbiMQTT::_writeLastValueTopic(const char *device_label, const char *variable_label) {
+  uint16_t deviceLabelLength = strlen(device_label);
+  uint16_t variableLabelLength = strlen(variable_label);
+  uint16_t topicLength = MQTT_TOPIC_PREFIX_LENGTH + deviceLabelLength + 1 + variableLabelLength + MQTT_LV_SUFFIX_LENGTH;
+  _writer.write(topicLength >> 8);
+  _writer.write(topicLength & 0xFF);
+  _writer.write((const uint8_t *)MQTT_TOPIC_PREFIX, MQTT_TOPIC_PREFIX_LENGTH);
+  _writer.write((const uint8_t *)device_label, deviceLabelLength);
+  _writer.write('/');
+  _writer.write((const uint8_t *)variable_label, variableLabelLength);
+  _writer.write((const uint8_t *)MQTT_LV_SUFFIX, MQTT_LV_SUFFIX_LENGTH);
+}
+
+bool UbiMQTT::_readByte(uint8_t *value) {
+  unsigned long start = millis();
+  while (!_client_mqtts_ubi.available()) {
+    if (millis() - start >= (unsigned long)_timeout || !_client_mqtts_ubi.connected()) {
+      return false;
+    }
+    delay(1);
+  }
+  *value = _client_mqtts_ubi.read();
+  return true;
+}
+
+/**
+ * Reads a whole packet, keeping up to UBI_MQTT_PACKET_SIZE bytes of it
+ * @return the fixed header, 0 on timeout. _packetLength is 0 if the packet
+ * did not fit.
+ */
+
+uint8_t UbiMQTT::_readPacket() {
+  uint8_t header;
+  if (!_readByte(&header)) {
+    return 0;
+  }
+
+  uint32_t remainingLength = 0;
+  uint32_t multiplier = 1;
+  uint8_t digit;
+  do {
+    if (!_readByte(&digit) || multiplier > 128UL * 128 * 128) {
+      return 0;
+    }
+    remainingLength += (digit & 0x7F) * multiplier;
+    multiplier *= 128;
+  } while (digit & 0x80);
+
+  for (uint32_t i = 0; i < remainingLength; i++) {
+    uint8_t c;
+    if (!_readByte(&c)) {
+      return 0;
+    }
+    if (i < UBI_MQTT_PACKET_SIZE) {
+      _packet[i] = c;
+    }
+  }
+  _packetLength = remainingLength <= UBI_MQTT_PACKET_SIZE ? remainingLength : 0;
+  return header;
+}
+
+/**
+ * Reads packets until the expected one arrives, incoming values are
+ * dispatched meanwhile
+ */
+
+bool UbiMQTT::_waitFor(uint8_t type, uint16_t packetId) {
+  while (true) {
+    uint8_t header = _readPacket();
+    if (header == 0) {
+      return false;
+    }
+    if ((header & 0xF0) == MQTT_PUBLISH) {
+      _handlePublish(header);
+      continue;
+    }
+    if ((header & 0xF0) != (type & 0xF0)) {
+      continue;
+    }
+    if (packetId == 0 || (_packetLength >= 2 && ((_packet[0] << 8) | _packet[1]) == packetId)) {
+      return true;
+    }
+  }
+}
+
+void UbiMQTT::_handlePublish(uint8_t header) {
+  uint8_t qos = (header >> 1) & 0x03;
+  if (_packetLength < 2) {
+    return;
+  }
+  uint16_t topicLength = (_packet[0] << 8) | _packet[1];
+  uint16_t position = 2 + topicLength;
+  if (position + (qos > 0 ? 2 : 0) > _packetLength) {
+    return;
+  }
+  const char *topic = (const char *)_packet + 2;
+
+  if (qos > 0) {
+    _writeHeader(MQTT_PUBACK, 2);
+    _writer.write(_packet[position]);
+    _writer.write(_packet[position + 1]);
+    _writer.flush();
+    position += 2;
+  }
+
+  char text[UBI_LAST_VALUE_SIZE];
+  uint16_t textLength = _packetLength - position;
+  if (textLength > sizeof(text) - 1) {
+    textLength = sizeof(text) - 1;
+  }
+  memcpy(text, _packet + position, textLength);
+  text[textLength] = '\0';
+  double value = atof(text);
+
+  // Topic is /v1.6/devices/{device_label}/{variable_label}/lv
+  if (topicLength < MQTT_TOPIC_PREFIX_LENGTH + MQTT_LV_SUFFIX_LENGTH + 3 ||
+      strncmp(topic, MQTT_TOPIC_PREFIX, MQTT_TOPIC_PREFIX_LENGTH) != 0) {
+    return;
+  }
+  const char *device = topic + MQTT_TOPIC_PREFIX_LENGTH;
+  const char *end = topic + topicLength - MQTT_LV_SUFFIX_LENGTH;
+  const char *separator = (const char *)memchr(device, '/', end - device);
+  if (separator == NULL) {
+    return;
+  }
+  uint16_t deviceLength = separator - device;
+  uint16_t variableLength = end - separator - 1;
+
+  if (_pendingDevice != NULL && strlen(_pendingDevice) == deviceLength &&
+      strncmp(_pendingDevice, device, deviceLength) == 0 && strlen(_pendingVariable) == variableLength &&
+      strncmp(_pendingVariable, separator + 1, variableLength) == 0) {
+    strcpy(_pendingText, text);
+    _pendingReceived = true;
+  }
+
+  for (uint8_t i = 0; i < _subscriptionsCount; i++) {
+    Subscription *subscription = &_subscriptions[i];
+    if (strlen(subscription->device_label) == deviceLength &&
+        strncmp(subscription->device_label, device, deviceLength) == 0 &&
+        strlen(subscription->variable_label) == variableLength &&
+        strncmp(subscription->variable_label, separator + 1, variableLength) == 0) {
+      subscription->callback(subscription->device_label, subscription->variable_label, value);
+    }
+  }
+}
@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiMqtt_H_
+#define _UbiMqtt_H_
+
+#include "UbiProtocol.h"
+
+class UbiMQTT : public UbiProtocol {
+public:
+  UbiMQTT(const char *host, const int port, const char *token);
+  bool sendData(const char *device_label, const char *device_name, char *payload);
+  bool getText(const char *device_label, const char *variable_label, char *text, size_t size);
+  bool serverConnected();
+  bool probe();
+  bool subscribe(const char *device_label, const char *variable_label, UbiSubscribeCallback callback);
+  bool loop();
+  void setQos(uint8_t qos) { _qos = qos > 1 ? 1 : qos; }
+  ~UbiMQTT();
+
+private:
+  typedef struct Subscription {
+    const char *device_label;
+    const char *variable_label;
+    UbiSubscribeCallback callback;
+  } Subscription;
+
+  WiFiSSLClient _client_mqtts_ubi;
+  UbiBufferedClient _writer;
+
+  char _clientId[18];
+  uint8_t _qos = 1;
+  uint16_t _packetId = 0;
+  unsigned long _lastOutbound = 0;
+
+  Subscription _subscriptions[UBI_MQTT_MAX_SUBSCRIPTIONS];
+  uint8_t _subscriptionsCount = 0;
+
+  uint8_t _packet[UBI_MQTT_PACKET_SIZE];
+  uint16_t _packetLength = 0;
+
+  const char *_pendingDevice = NULL;
+  const char *_pendingVariable = NULL;
+  bool _pendingReceived = false;
+  char _pendingText[UBI_LAST_VALUE_SIZE];
+
+  bool _connect();
+  bool _subscribeTopic(uint8_t type, const char *device_label, const char *variable_label);
+  uint16_t _nextPacketId();
+  void _writeHeader(uint8_t header, uint32_t remainingLength);
+  void _writeString(const char *text, uint16_t length);
+  void _writeLastValueTopic(const char *device_label, const char *variable_label);
+  bool _readByte(uint8_t *value);
+  uint8_t _readPacket();
+  bool _waitFor(uint8_t type, uint16_t packetId);
+  void _handlePublish(uint8_t header);
+};
+
+#endif
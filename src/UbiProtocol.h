@@ -28,7 +28,12 @@ Inc
 #include <WiFiNINA.h>
 #include <WiFiUdp.h>
 
+#include "UbiBufferedClient.h"
+#include "UbiClock.h"
+#include "UbiConnectionPool.h"
 #include "UbiConstants.h"
+#include "UbiLog.h"
+#include "UbiTrace.h"
 
 class UbiProtocol {
 protected:
@@ -39,17 +44,50 @@ protected:
   const char *_host;
   const char *_token;
   int _port;
+  UbiClock *_clock = NULL;
+  UbiTrace *_trace = NULL;
+  UbiConnectionPool *_pool = NULL;
+  // Wait asked by the server in a Retry-After header, in milliseconds
+  unsigned long _retryAfter = 0;
+
+  inline void _traceEvent(UbiTraceEventId id, uint16_t arg0 = 0, uint32_t arg1 = 0) {
+    if (_trace != NULL) {
+      _trace->record(id, arg0, arg1);
+    }
+  }
 
 public:
   explicit UbiProtocol(const char *host, const char *token, int port) : _host(host), _token(token), _port(port) {
     _timeout = 5000;
-    _debug = false;
+    _debug = UBI_DEBUG_DEFAULT;
     _maxReconnectAttempts = 5;
   }
 
   virtual bool sendData(const char *device_label, const char *device_name, char *payload) = 0;
-  virtual double get(const char *device_label, const char *variable_label) = 0;
-  virtual bool serverConnected();
+  virtual bool getText(const char *device_label, const char *variable_label, char *text, size_t size) = 0;
+  virtual bool serverConnected() = 0;
+  virtual bool probe() = 0;
+  virtual ~UbiProtocol() {}
+
+  /**
+   * Last value of a variable, read from the text the server answers with
+   * @return ERROR_VALUE if it could not be read or is not a number
+   */
+  double get(const char *device_label, const char *variable_label) {
+    char text[UBI_LAST_VALUE_SIZE];
+    if (!getText(device_label, variable_label, text, sizeof(text))) {
+      return ERROR_VALUE;
+    }
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text) {
+      if (UBI_LOG_ERROR) {
+        Serial.println(F("[ERROR] The last value is not a number"));
+      }
+      return ERROR_VALUE;
+    }
+    return value;
+  }
 
   /**
    * Reconnects to the server
@@ -60,14 +98,14 @@ public:
 
     uint8_t attempts = 0;
     while (!client->connected() && attempts < _maxReconnectAttempts) {
-      if (_debug) {
+      if (UBI_LOG_INFO) {
         Serial.print(F("Trying to connect to "));
         Serial.print(_host);
         Serial.print(F(" , attempt number: "));
         Serial.println(attempts);
       }
       client->connectSSL(_host, _port);
-      if (_debug) {
+      if (UBI_LOG_INFO) {
         Serial.println(F("Attempt finished"));
       }
       attempts++;
@@ -85,6 +123,104 @@ public:
     return false;
   }
 
+  /**
+   * Connects the client of a request. With a connection pool attached the
+   * client is taken from the pool, which reuses an idle connection to the
+   * same server if there is one.
+   * @arg own_client [Mandatory] client of the protocol, used without pool
+   * @arg client [Mandatory] set to the connected client
+   * @return false if the server could not be reached
+   */
+  bool connectClient(WiFiSSLClient *own_client, WiFiSSLClient **client) {
+    if (UBI_LOG_INFO) {
+      Serial.print(F("Connecting to "));
+      Serial.print(_host);
+      Serial.print(F(" on Port: "));
+      Serial.println(_port);
+    }
+    _traceEvent(UBI_TRACE_CONNECT_BEGIN, _port);
+
+    WiFiSSLClient *connected = own_client;
+    if (_pool != NULL) {
+      connected = _pool->acquire(_host, _port);
+    } else if (!own_client->connectSSL(_host, _port)) {
+      if (UBI_LOG_ERROR) {
+        Serial.println(F("Connection Failed to Ubidots - Try Again"));
+      }
+      if (!reconnect<WiFiSSLClient>(own_client)) {
+        connected = NULL;
+      }
+    }
+
+    _traceEvent(UBI_TRACE_CONNECT_END, connected != NULL);
+    if (connected == NULL) {
+      if (UBI_LOG_ERROR) {
+        Serial.println(F("[ERROR] Could not connect to the server"));
+      }
+      return false;
+    }
+    *client = connected;
+    return true;
+  }
+
+  /**
+   * Ends the request of a client connected by connectClient()
+   * @arg keep_alive [Mandatory] the pool keeps the connection opened for the
+   * next request, ignored without pool
+   */
+  void disconnectClient(WiFiSSLClient *client, bool keep_alive) {
+    if (_pool != NULL) {
+      _pool->release(client, keep_alive);
+      return;
+    }
+    client->flush();
+    client->stop();
+  }
+
+  /**
+   * Prints how many SPI transactions and TLS records the last request took
+   */
+  void printWriterStats(const UbiBufferedClient &writer) {
+    Serial.print(F("Request written in "));
+    Serial.print(writer.transactions());
+    Serial.print(F(" transactions, "));
+    Serial.print(writer.records());
+    Serial.print(F(" records, "));
+    Serial.print(writer.bytes());
+    Serial.print(F(" bytes from "));
+    Serial.print(writer.writes());
+    Serial.println(F(" writes"));
+  }
+
+  /**
+   * Clock to be synced from the server answers when the protocol allows it
+   */
+
+  inline void setClock(UbiClock *clock) { _clock = clock; }
+
+  /**
+   * Trace sink for the connection and request events
+   */
+
+  inline void setTrace(UbiTrace *trace) { _trace = trace; }
+
+  /**
+   * Connections shared with other instances, only used by TCP and HTTP
+   */
+
+  inline void setConnectionPool(UbiConnectionPool *pool) { _pool = pool; }
+
+  /**
+   * @return the wait in milliseconds asked by the last answer of the server,
+   * 0 if none, and forgets it
+   */
+
+  inline unsigned long takeRetryAfter() {
+    unsigned long retryAfter = _retryAfter;
+    _retryAfter = 0;
+    return retryAfter;
+  }
+
   /**
    * Makes available debug traces
    */
@@ -24,6 +24,9 @@ Inc
 
 #include "UbiProtocolHandler.h"
 
+#include <errno.h>
+#include <stdarg.h>
+
 #include "UbiUtils.h"
 
 /**************************************************************************
@@ -41,8 +44,14 @@ UbiProtocolHandler::UbiProtocolHandler(const char *token, UbiServer server, IotP
 void UbiProtocolHandler::_builder(const char *token, UbiServer server, IotProtocol iot_protocol) {
   _iot_protocol = iot_protocol;
   UbiBuilder builder(server, token, _iot_protocol);
-  _dots = (Value *)malloc(MAX_VALUES * sizeof(Value));
+  _dotBuffers[0] = (Value *)malloc(MAX_VALUES * sizeof(Value));
+  _dotBuffers[1] = (Value *)malloc(MAX_VALUES * sizeof(Value));
+  _dots = _dotBuffers[0];
   _ubiProtocol = builder.builder();
+  _configureTransport(_ubiProtocol);
+  _transports[iot_protocol] = _ubiProtocol;
+  _lastTransport = iot_protocol;
+  _server = server;
   _token = token;
   _current_value = 0;
 }
@@ -52,8 +61,12 @@ void UbiProtocolHandler::_builder(const char *token, UbiServer server, IotProtoc
  ***************************************************************************/
 
 UbiProtocolHandler::~UbiProtocolHandler() {
-  free(_dots);
-  delete _ubiProtocol;
+  free(_dotBuffers[0]);
+  free(_dotBuffers[1]);
+  free(_frameDots);
+  for (uint8_t i = 0; i < NUMBER_OF_SUPPORTED_PROTOCOLS; i++) {
+    delete _transports[i];
+  }
 }
 
 /***************************************************************************
@@ -72,19 +85,134 @@ FUNCTIONS TO SEND DATA
  */
 
 void UbiProtocolHandler::add(const char *variable_label, float value, char *context,
-                             unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis) {
-  (_dots + _current_value)->variable_label = variable_label;
-  (_dots + _current_value)->dot_value = value;
-  (_dots + _current_value)->dot_context = context;
-  (_dots + _current_value)->dot_timestamp_seconds = dot_timestamp_seconds;
-  (_dots + _current_value)->dot_timestamp_millis = dot_timestamp_millis;
-  _current_value++;
-  if (_current_value > MAX_VALUES) {
-    if (_debug) {
-      Serial.println(F("You are sending more than the maximum of consecutive variables"));
+                             unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis,
+                             UbiPriority priority) {
+  Value dot;
+  dot.dot_value = value;
+  dot.value_type = UBI_VALUE_FLOAT;
+  _addDot(variable_label, dot, context, NULL, _toTimestamp(dot_timestamp_seconds, dot_timestamp_millis), priority);
+}
+
+/**
+ * Add a value of variable to save with an owned context
+ * @arg context [Mandatory] UbiContext to attach to the dot. It is referenced,
+ * not copied, so it must be alive until send() returns
+ */
+
+void UbiProtocolHandler::add(const char *variable_label, float value, const UbiContext *context,
+                             unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis,
+                             UbiPriority priority) {
+  Value dot;
+  dot.dot_value = value;
+  dot.value_type = UBI_VALUE_FLOAT;
+  _addDot(variable_label, dot, NULL, context, _toTimestamp(dot_timestamp_seconds, dot_timestamp_millis), priority);
+}
+
+/**
+ * Typed dots, sent with all their digits instead of through a float
+ * @arg value [Mandatory] integer value, or the fixed-point value times
+ * 10^decimals
+ * @arg decimals [Mandatory] number of decimals of a fixed-point value
+ * @arg context [Optional] UbiContext to attach to the dot, NULL for none
+ */
+
+void UbiProtocolHandler::addInt(const char *variable_label, int64_t value, const UbiContext *context,
+                                unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis,
+                                UbiPriority priority) {
+  Value dot;
+  dot.dot_int = value;
+  dot.value_type = UBI_VALUE_INT;
+  _addDot(variable_label, dot, NULL, context, _toTimestamp(dot_timestamp_seconds, dot_timestamp_millis), priority);
+}
+
+void UbiProtocolHandler::addFixed(const char *variable_label, int64_t value, uint8_t decimals,
+                                  const UbiContext *context, unsigned long dot_timestamp_seconds,
+                                  unsigned int dot_timestamp_millis, UbiPriority priority) {
+  if (decimals > UBI_MAX_DECIMALS) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("ERROR, a fixed-point value can have up to 18 decimals"));
+    }
+    return;
+  }
+  Value dot;
+  dot.dot_int = value;
+  dot.value_type = UBI_VALUE_FIXED;
+  dot.value_scale = decimals;
+  _addDot(variable_label, dot, NULL, context, _toTimestamp(dot_timestamp_seconds, dot_timestamp_millis), priority);
+}
+
+void UbiProtocolHandler::addDouble(const char *variable_label, double value, const UbiContext *context,
+                                   unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis,
+                                   UbiPriority priority) {
+  Value dot;
+  dot.dot_double = value;
+  dot.value_type = UBI_VALUE_DOUBLE;
+  _addDot(variable_label, dot, NULL, context, _toTimestamp(dot_timestamp_seconds, dot_timestamp_millis), priority);
+}
+
+/**
+ * Adds a dot whose value was queued with its type, e.g. by the gateway
+ * @arg dot_timestamp [Mandatory] milliseconds since the epoch, 0 for none
+ */
+
+void UbiProtocolHandler::addValue(const char *variable_label, const UbiTypedValue &value, const UbiContext *context,
+                                  uint64_t dot_timestamp, UbiPriority priority) {
+  if (value.value_type == UBI_VALUE_FIXED && value.value_scale > UBI_MAX_DECIMALS) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("ERROR, a fixed-point value can have up to 18 decimals"));
     }
-    _current_value = MAX_VALUES;
+    return;
+  }
+  Value dot;
+  dot.value_type = value.value_type;
+  dot.value_scale = value.value_scale;
+  memcpy(&dot.dot_int, &value.dot_int, sizeof(dot.dot_int));
+  _addDot(variable_label, dot, NULL, context, dot_timestamp, priority);
+}
+
+uint64_t UbiProtocolHandler::_toTimestamp(unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis) {
+  if (dot_timestamp_seconds == 0) {
+    return 0;
   }
+  return (uint64_t)dot_timestamp_seconds * 1000 + dot_timestamp_millis;
+}
+
+/**
+ * Stores a dot
+ * @arg value [Mandatory] dot holding the typed value
+ * @arg dot_timestamp [Mandatory] milliseconds since the epoch, 0 stamps the
+ * dot with the time it was added at once the clock is synced
+ * @arg priority [Mandatory] high priority dots are due to be sent right away,
+ * low priority ones once a bulk threshold is reached
+ * Dots can be added from interrupts while send() runs: the producers only
+ * contend on the reservation of a slot, made with interrupts disabled, and
+ * fill it afterwards. send() is the single consumer and runs in the main loop,
+ * so it never sees a reserved slot before it is filled. Nothing here talks to
+ * the WiFi module or prints, the clock is read and the errors are logged by
+ * send().
+ */
+
+void UbiProtocolHandler::_addDot(const char *variable_label, const Value &value, char *context,
+                                 const UbiContext *context_ref, uint64_t dot_timestamp, UbiPriority priority) {
+  unsigned long added_at = millis();
+
+  noInterrupts();
+  if (_current_value >= MAX_VALUES) {
+    _overflowedDots++;
+    interrupts();
+    return;
+  }
+  Value *dot = _dots + _current_value;
+  _current_value++;
+  interrupts();
+
+  *dot = value;
+  dot->variable_label = variable_label;
+  dot->dot_context = context;
+  dot->dot_context_ref = context_ref;
+  dot->dot_timestamp = dot_timestamp;
+  dot->priority = priority;
+  dot->added_at = added_at;
 }
 
 /**
@@ -95,157 +223,1038 @@ void UbiProtocolHandler::add(const char *variable_label, float value, char *cont
  */
 
 bool UbiProtocolHandler::send(const char *device_label, const char *device_name) {
-  // Builds the payload
-  char *payload = (char *)malloc(sizeof(char) * MAX_BUFFER_SIZE);
-  if (_iot_protocol == UBI_TCP || _iot_protocol == UBI_UDP) {
-    buildTcpPayload(payload, device_label, device_name);
-  } else {
-    buildHttpPayload(payload);
+  // While throttled the dots stay in the buffer and go in the next, larger, batch
+  if (!_limiter.acquire(_current_value, millis())) {
+    _trace.record(UBI_TRACE_THROTTLED, _current_value, _limiter.holdRemaining(millis()));
+    if (UBI_LOG_INFO) {
+      Serial.println(F("Rate limit reached, the dots are kept for the next send()"));
+    }
+    return false;
   }
 
+  // Swaps the buffers, the dots added while the batch is sent go to the other one
+  noInterrupts();
+  Value *batch = _dots;
+  uint8_t dotsToSend = _current_value;
+  _activeBuffer ^= 1;
+  _dots = _dotBuffers[_activeBuffer];
+  _current_value = 0;
+  uint16_t overflowedDots = _overflowedDots;
+  _overflowedDots = 0;
+  interrupts();
+  _trace.record(UBI_TRACE_SEND_BEGIN, dotsToSend);
+
+  if (overflowedDots > 0 && UBI_LOG_ERROR) {
+    Serial.print(F("You are sending more than the maximum of consecutive variables, dots dropped: "));
+    Serial.println(overflowedDots);
+  }
+  _stampDots(batch, dotsToSend);
+
   // Sends data
-  if (_debug) {
-    Serial.println("Sending data...");
+  if (UBI_LOG_DEBUG) {
+    Serial.println(F("Sending data..."));
   }
 
-  bool result = _ubiProtocol->sendData(device_label, device_name, payload);
+  char *payload = (char *)malloc(sizeof(char) * MAX_BUFFER_SIZE);
+  bool result;
+  // Dots written in the payload, the ones that do not fit go with the next send()
+  uint8_t sent = dotsToSend;
+  bool pipelined = _iot_protocol == UBI_TCP && static_cast<UbiTCP *>(_ubiProtocol)->pipelined();
+  if (pipelined) {
+    _batchId++;
+    sent = _buildPayload(payload, _iot_protocol, batch, dotsToSend, device_label, device_name);
+    result = (sent > 0 || dotsToSend == 0) && static_cast<UbiTCP *>(_ubiProtocol)->pipelinePost(payload);
+    if (result) {
+      _pushFrame(device_label, batch, sent);
+    }
+  } else if (_failover.active()) {
+    _batchId++;
+    result = _sendWithFailover(payload, batch, dotsToSend, device_label, device_name, &sent);
+  } else {
+    _batchId++;
+    sent = _buildPayload(payload, _iot_protocol, batch, dotsToSend, device_label, device_name);
+    result = (sent > 0 || dotsToSend == 0) && _sendWithRetries(_iot_protocol, device_label, device_name, payload);
+    _lastTransport = _iot_protocol;
+  }
   free(payload);
-  if (result) {
-    _current_value = 0;
+  _trace.record(UBI_TRACE_SEND_END, result, _batchId);
+
+  // A dot that does not fit even alone in a payload could never be sent
+  uint8_t dropped = 0;
+  if (sent == 0 && dotsToSend > 0) {
+    dropped = 1;
+    if (UBI_LOG_ERROR) {
+      Serial.print(F("[ERROR] The dot does not fit in the payload, dropped, variable: "));
+      Serial.println(batch->variable_label);
+    }
+  }
+  if (sent + dropped < dotsToSend) {
+    _requeue(batch + sent + dropped, dotsToSend - sent - dropped);
+  }
+  if (!result) {
+    if (sent > 0) {
+      _requeue(batch, sent);
+    }
+    return false;
+  }
+  // A queued frame is accounted for once it is answered, see _onFrameAnswered()
+  if (pipelined) {
+    return true;
   }
 
-  _current_value = 0;
-  return result;
+  // HTTP may answer with the status of every dot, only the failed ones are sent again
+  uint8_t failed = 0;
+  uint8_t rejected = 0;
+  if (_lastTransport == UBI_HTTP && static_cast<UbiHTTP *>(_transports[UBI_HTTP])->hasDotStatuses()) {
+    failed = _partitionFailedDots(batch, sent, &rejected);
+    if (failed > 0) {
+      _requeue(batch, failed);
+    }
+  }
+
+  _acknowledge(device_label, batch + failed + rejected, sent - failed - rejected);
+  return failed == 0 && rejected == 0;
+}
+
+/**
+ * The cached last values of the variables just stored are outdated, and the
+ * latency of the dots ends with the acknowledge
+ */
+
+void UbiProtocolHandler::_acknowledge(const char *device_label, const Value *dots, uint8_t dots_count) {
+  for (uint8_t i = 0; i < dots_count; i++) {
+    _cache.invalidate(device_label, (dots + i)->variable_label);
+    _latency[(dots + i)->priority].record(millis() - (dots + i)->added_at);
+  }
+}
+
+/**
+ * Keeps what the answer of a pipelined frame needs, getPipelined() frames
+ * take a slot with no dots so that the answers stay matched in order
+ */
+
+void UbiProtocolHandler::_pushFrame(const char *device_label, const Value *dots, uint8_t dots_count) {
+  uint8_t index = (_framesHead + _framesCount) % UBI_PIPELINE_DEPTH;
+  PipelinedFrame *frame = &_frames[index];
+  // A label too long for the cache has no cached value to invalidate
+  if (strlen(device_label) < UBI_CACHE_LABEL_SIZE) {
+    strcpy(frame->device_label, device_label);
+  } else {
+    frame->device_label[0] = '\0';
+  }
+  frame->dots = dots_count;
+  for (uint8_t i = 0; i < dots_count; i++) {
+    PipelinedDot *dot = &_frameDots[index * MAX_VALUES + i];
+    dot->variable_label = (dots + i)->variable_label;
+    dot->added_at = (dots + i)->added_at;
+    dot->priority = (dots + i)->priority;
+  }
+  _framesCount++;
+}
+
+/**
+ * The dots of a frame the server did not acknowledge are not sent again, the
+ * callback given to beginPipeline() is told about it
+ */
+
+void UbiProtocolHandler::_onFrameAnswered(void *context, bool success) {
+  UbiProtocolHandler *handler = static_cast<UbiProtocolHandler *>(context);
+  if (handler->_framesCount == 0) {
+    return;
+  }
+  uint8_t index = handler->_framesHead;
+  const PipelinedFrame *frame = &handler->_frames[index];
+  handler->_framesHead = (index + 1) % UBI_PIPELINE_DEPTH;
+  handler->_framesCount--;
+  if (!success) {
+    return;
+  }
+  for (uint8_t i = 0; i < frame->dots; i++) {
+    const PipelinedDot *dot = &handler->_frameDots[index * MAX_VALUES + i];
+    if (frame->device_label[0] != '\0') {
+      handler->_cache.invalidate(frame->device_label, dot->variable_label);
+    }
+    handler->_latency[dot->priority].record(millis() - dot->added_at);
+  }
+}
+
+/**
+ * Stamps the dots added without timestamp with the time they were added at,
+ * so batched dots and retried batches keep the time they were taken at. Done
+ * here and not in add(), as reading the clock may ask the WiFi module.
+ */
+
+void UbiProtocolHandler::_stampDots(Value *dots, uint8_t dots_count) {
+  if (!_autoTimestamp) {
+    return;
+  }
+  uint64_t now = 0;
+  for (uint8_t i = 0; i < dots_count; i++) {
+    Value *dot = dots + i;
+    if (dot->dot_timestamp != 0) {
+      continue;
+    }
+    if (now == 0) {
+      now = _clock.now();
+      if (now == 0) {
+        return;
+      }
+    }
+    dot->dot_timestamp = now - (millis() - dot->added_at);
+  }
+}
+
+/**
+ * Sorts the batch by the status the server gave to every dot: first the dots
+ * to retry (throttled or server error), then the rejected ones, then the
+ * accepted ones. Dots missing from the answer are taken as accepted. The
+ * batch is in the order of the payload, so the n-th dot of a variable is the
+ * n-th object of its array in the answer.
+ * @arg rejected [Mandatory] Pointer to store the number of rejected dots
+ * @return the number of dots to retry
+ */
+
+uint8_t UbiProtocolHandler::_partitionFailedDots(Value *batch, uint8_t dots_count, uint8_t *rejected) {
+  UbiHTTP *http = static_cast<UbiHTTP *>(_transports[UBI_HTTP]);
+  // Read before sorting, only the dots already visited are moved
+  int16_t statuses[MAX_VALUES];
+  uint8_t index = 0;
+  for (uint8_t i = 0; i < dots_count; i++) {
+    const char *label = (batch + i)->variable_label;
+    index = i > 0 && strcmp((batch + i - 1)->variable_label, label) == 0 ? index + 1 : 0;
+    statuses[i] = http->dotStatus(label, index);
+  }
+
+  uint8_t failed = 0;
+  *rejected = 0;
+  for (uint8_t i = 0; i < dots_count; i++) {
+    int16_t status = statuses[i];
+    bool retry = status == 429 || status >= 500;
+    bool reject = !retry && status >= 400;
+    if (!retry && !reject) {
+      continue;
+    }
+    if (reject && UBI_LOG_ERROR) {
+      Serial.print(F("Dot rejected by the server, variable: "));
+      Serial.print((batch + i)->variable_label);
+      Serial.print(F(", status: "));
+      Serial.println(status);
+    }
+    // Keeps [retry dots][rejected dots][accepted dots]
+    Value dot = *(batch + i);
+    uint8_t end = failed + *rejected;
+    memmove(batch + end + 1, batch + end, (i - end) * sizeof(Value));
+    if (retry) {
+      memmove(batch + failed + 1, batch + failed, *rejected * sizeof(Value));
+      *(batch + failed) = dot;
+      failed++;
+    } else {
+      *(batch + end) = dot;
+      (*rejected)++;
+    }
+  }
+  return failed;
+}
+
+/**
+ * Puts the dots of a failed batch back in front of the dots added while it
+ * was sent, so the next send() carries them again. The newest dots of the
+ * batch are kept if both do not fit. As in _addDot(), only the reservation is
+ * made with interrupts disabled: the dots added from now on go after the
+ * reserved slots, and the dots already added are filled, since the producers
+ * that reserved them either returned or are this loop, so they are moved
+ * with interrupts enabled.
+ */
+
+void UbiProtocolHandler::_requeue(const Value *batch, uint8_t dots_count) {
+  noInterrupts();
+  uint8_t added = _current_value;
+  uint8_t room = MAX_VALUES - added;
+  uint8_t kept = dots_count < room ? dots_count : room;
+  _current_value += kept;
+  interrupts();
+
+  memmove(_dots + kept, _dots, added * sizeof(Value));
+  memcpy(_dots, batch + dots_count - kept, kept * sizeof(Value));
+  _trace.record(UBI_TRACE_REQUEUE, kept, dots_count - kept);
+
+  if (kept < dots_count && UBI_LOG_ERROR) {
+    Serial.print(F("Dots dropped from the failed batch: "));
+    Serial.println(dots_count - kept);
+  }
+}
+
+/**
+ * Builds the payload in the format of the transport
+ * @return the number of dots, from the start of the batch, that fit in it
+ */
+
+uint8_t UbiProtocolHandler::_buildPayload(char *payload, IotProtocol iot_protocol, Value *dots, uint8_t dots_count,
+                                          const char *device_label, const char *device_name) {
+  uint8_t written;
+  if (iot_protocol == UBI_TCP || iot_protocol == UBI_UDP) {
+    written = buildTcpPayload(payload, dots, dots_count, device_label, device_name);
+  } else {
+    written = buildHttpPayload(payload, dots, dots_count);
+  }
+  _trace.record(UBI_TRACE_PAYLOAD_BUILT, written, strlen(payload));
+  if (written < dots_count && UBI_LOG_INFO) {
+    Serial.print(F("Payload full, dots left for the next send(): "));
+    Serial.println(dots_count - written);
+  }
+  return written;
+}
+
+/**
+ * Appends formatted text to a payload of MAX_BUFFER_SIZE - reserved bytes
+ * @arg length [Mandatory] length of the payload
+ * @return the new length, or the size of the payload once the text does not
+ * fit, which makes the next appends do nothing
+ */
+
+size_t UbiProtocolHandler::_appendf(char *payload, size_t length, size_t reserved, const char *format, ...) {
+  size_t size = MAX_BUFFER_SIZE - reserved;
+  if (length >= size) {
+    return size;
+  }
+  va_list args;
+  va_start(args, format);
+  int written = vsnprintf(payload + length, size - length, format, args);
+  va_end(args);
+  if (written < 0 || length + written >= size) {
+    return size;
+  }
+  return length + written;
+}
+
+/**
+ * Sends the batch through the healthiest transport, and through the next one
+ * while they fail. Batches made only of low priority dots may go over UDP.
+ */
+
+bool UbiProtocolHandler::_sendWithFailover(char *payload, Value *dots, uint8_t dots_count, const char *device_label,
+                                           const char *device_name, uint8_t *sent) {
+  *sent = dots_count;
+  UbiOperation operation = UBI_OPERATION_SEND_UNACKNOWLEDGED;
+  for (uint8_t i = 0; i < dots_count; i++) {
+    if ((dots + i)->priority != UBI_PRIORITY_LOW) {
+      operation = UBI_OPERATION_SEND;
+    }
+  }
+
+  uint8_t tried = 0;
+  IotProtocol transport;
+  while (_failover.select(operation, tried, &transport)) {
+    tried |= 1 << transport;
+    *sent = _buildPayload(payload, transport, dots, dots_count, device_label, device_name);
+    if (*sent == 0 && dots_count > 0) {
+      return false;
+    }
+    unsigned long start = millis();
+    bool result = _sendWithRetries(transport, device_label, device_name, payload);
+    _failover.report(transport, result, millis() - start);
+    if (result) {
+      _lastTransport = transport;
+      return true;
+    }
+    // The limits of the account apply to every transport
+    if (_limiter.holdRemaining(millis()) > 0) {
+      return false;
+    }
+    if (UBI_LOG_ERROR) {
+      Serial.print(F("Transport failed, failing over from protocol "));
+      Serial.println(transport);
+    }
+  }
+  return false;
+}
+
+/**
+ * Sends the same payload until the server acknowledges it, the retry limit is
+ * reached or the retry budget is spent. The payload is built once, so every
+ * attempt of a batch carries the same batch id and dot timestamps.
+ */
+
+bool UbiProtocolHandler::_sendWithRetries(IotProtocol iot_protocol, const char *device_label, const char *device_name,
+                                          char *payload) {
+  UbiProtocol *transport = _transports[iot_protocol];
+  // UDP has no answer, a retry could never tell a lost answer from a lost batch
+  uint8_t maxRetries = iot_protocol == UBI_UDP ? 0 : _maxRetries;
+  unsigned long start = millis();
+  unsigned long backoff = UBI_RETRY_BACKOFF;
+
+  for (uint8_t attempt = 0;; attempt++) {
+    if (UBI_LOG_DEBUG) {
+      Serial.print(F("Batch "));
+      Serial.print(_batchId);
+      Serial.print(F(", attempt "));
+      Serial.println(attempt + 1);
+    }
+    if (attempt > 0) {
+      _trace.record(UBI_TRACE_RETRY, attempt, _batchId);
+    }
+    if (transport->sendData(device_label, device_name, payload)) {
+      return true;
+    }
+    // 429 or 503 with Retry-After, nothing is sent until the server is ready again
+    unsigned long retryAfter = transport->takeRetryAfter();
+    if (retryAfter > 0) {
+      _limiter.holdFor(retryAfter, millis());
+      _trace.record(UBI_TRACE_THROTTLED, 0, retryAfter);
+      if (UBI_LOG_ERROR) {
+        Serial.print(F("Server busy, retrying after ms: "));
+        Serial.println(retryAfter);
+      }
+      return false;
+    }
+    if (attempt >= maxRetries || millis() - start + backoff > _retryBudget) {
+      return false;
+    }
+    delay(backoff);
+    backoff *= 2;
+  }
+}
+
+/**
+ * Retries for the batches whose answer is lost or negative. send() stamps the
+ * dots before the first attempt, so a batch that reached the server and is
+ * sent again overwrites its dots instead of duplicating them.
+ * @arg max_retries [Mandatory] retries per batch, up to UBI_MAX_RETRIES. 0
+ * disables the retries.
+ * @arg retry_budget [Mandatory] maximum time in ms spent retrying a batch
+ */
+
+void UbiProtocolHandler::setRetryPolicy(uint8_t max_retries, unsigned long retry_budget) {
+  _maxRetries = max_retries > UBI_MAX_RETRIES ? UBI_MAX_RETRIES : max_retries;
+  _retryBudget = retry_budget;
+}
+
+/**
+ * Binary traces of the sends and requests, written to the output from loop()
+ * instead of printing while the request is in flight. Decode them with
+ * extras/trace_decoder/ubitrace.py.
+ * @arg output [Mandatory] where the traces are written, NULL stops tracing
+ */
+
+bool UbiProtocolHandler::setTrace(Print *output) {
+  if (output == NULL) {
+    _trace.end();
+    return true;
+  }
+  return _trace.begin(output);
+}
+
+/**
+ * Tells if the pending dots have to be sent: there is a high priority dot, or
+ * the low priority dots reached one of the bulk thresholds. Normal priority
+ * dots only leave on an explicit send().
+ */
+
+bool UbiProtocolHandler::flushDue() {
+  uint8_t lowDots = 0;
+  unsigned long oldestLowDot = 0;
+  uint16_t payloadBytes = 0;
+  for (uint8_t i = 0; i < _current_value; i++) {
+    Value *dot = _dots + i;
+    if (dot->priority == UBI_PRIORITY_HIGH) {
+      return true;
+    }
+    payloadBytes += strlen(dot->variable_label) + UBI_DOT_PAYLOAD_OVERHEAD;
+    if (dot->priority == UBI_PRIORITY_LOW) {
+      lowDots++;
+      if (millis() - dot->added_at > oldestLowDot) {
+        oldestLowDot = millis() - dot->added_at;
+      }
+    }
+  }
+  if (lowDots == 0) {
+    return false;
+  }
+  return lowDots >= _bulkMaxDots || oldestLowDot >= _bulkMaxAge || payloadBytes >= _bulkMaxBytes ||
+         _current_value >= MAX_VALUES;
 }
 
+/**
+ * Sets when the pending low priority dots are sent
+ * @arg max_dots [Mandatory] number of low priority dots
+ * @arg max_age [Mandatory] age in milliseconds of the oldest low priority dot
+ * @arg max_bytes [Mandatory] estimated size of the payload
+ */
+
+void UbiProtocolHandler::setBulkThresholds(uint8_t max_dots, unsigned long max_age, uint16_t max_bytes) {
+  _bulkMaxDots = max_dots;
+  _bulkMaxAge = max_age;
+  _bulkMaxBytes = max_bytes;
+}
+
+/**
+ * Dots added without timestamp are stamped with the synced clock, enabled by
+ * default
+ */
+
+void UbiProtocolHandler::setAutoTimestamp(bool auto_timestamp) { _autoTimestamp = auto_timestamp; }
+
 double UbiProtocolHandler::get(const char *device_label, const char *variable_label) {
-  if (_iot_protocol == UBI_UDP) {
-    Serial.println("ERROR, data retrieval is only supported using TCP or HTTP protocols");
+  double value = ERROR_VALUE;
+
+  if (_cache.enabled() && _cache.lookup(device_label, variable_label, &value) != UBI_CACHE_MISS) {
+    if (UBI_LOG_DEBUG) {
+      Serial.println(F("Value served from the cache"));
+    }
+    _trace.record(UBI_TRACE_CACHE_HIT);
+    return value;
+  }
+
+  char text[UBI_LAST_VALUE_SIZE];
+  if (!_getText(device_label, variable_label, text, sizeof(text))) {
     return ERROR_VALUE;
   }
+  return strtod(text, NULL);
+}
 
-  double value = ERROR_VALUE;
+/**
+ * Typed last values, read from the digits the server answers with instead of
+ * through a double, so they always ask the server and skip the cache.
+ * @arg value [Mandatory] Pointer to store the value, left as is on error
+ * @return false if the value could not be read or does not fit
+ */
 
-  value = _ubiProtocol->get(device_label, variable_label);
+bool UbiProtocolHandler::getInt(const char *device_label, const char *variable_label, int64_t *value) {
+  char text[UBI_LAST_VALUE_SIZE];
+  if (!_getText(device_label, variable_label, text, sizeof(text))) {
+    return false;
+  }
+  char *end;
+  errno = 0;
+  long long result = strtoll(text, &end, 10);
+  if (end != text && *end == '\0' && errno != ERANGE) {
+    *value = result;
+    return true;
+  }
+  // Values such as "21.0" or "1e3" are rounded from their digits
+  return UbiUtils::charToFixed(text, 0, value);
+}
 
-  return value;
+/**
+ * @arg decimals [Mandatory] the value is stored times 10^decimals
+ */
+
+bool UbiProtocolHandler::getFixed(const char *device_label, const char *variable_label, uint8_t decimals,
+                                  int64_t *value) {
+  char text[UBI_LAST_VALUE_SIZE];
+  if (decimals > UBI_MAX_DECIMALS || !_getText(device_label, variable_label, text, sizeof(text))) {
+    return false;
+  }
+  return UbiUtils::charToFixed(text, decimals, value);
+}
+
+bool UbiProtocolHandler::getDouble(const char *device_label, const char *variable_label, double *value) {
+  double result = get(device_label, variable_label);
+  if (result == ERROR_VALUE) {
+    return false;
+  }
+  *value = result;
+  return true;
 }
 
 /**
- * Builds the HTTP payload to send and saves it to the input char pointer.
- * @payload [Mandatory] char payload pointer to store the built structure.
- * @timestamp_global [Optional] If set, it will be used for any dot without
- * timestamp.
- */
-
-void UbiProtocolHandler::buildHttpPayload(char *payload) {
-  /* Builds the payload */
-  sprintf(payload, "{");
-
-  for (uint8_t i = 0; i < _current_value;) {
-    char str_value[20];
-    UbiUtils::floatToChar(str_value, (_dots + i)->dot_value);
-    sprintf(payload, "%s\"%s\":{\"value\":%s", payload, (_dots + i)->variable_label, str_value);
-
-    // Adds timestamp seconds
-    if ((_dots + i)->dot_timestamp_seconds != NULL) {
-      sprintf(payload, "%s,\"timestamp\":%lu", payload, (_dots + i)->dot_timestamp_seconds);
-      // Adds timestamp milliseconds
-      if ((_dots + i)->dot_timestamp_millis != NULL) {
-        char milliseconds[3];
-        int timestamp_millis = (_dots + i)->dot_timestamp_millis;
-        uint8_t units = timestamp_millis % 10;
-        uint8_t dec = (timestamp_millis / 10) % 10;
-        uint8_t hund = (timestamp_millis / 100) % 10;
-        sprintf(milliseconds, "%d%d%d", hund, dec, units);
-        sprintf(payload, "%s%s", payload, milliseconds);
-      } else {
-        sprintf(payload, "%s000", payload);
-      }
+ * Last value cache in front of get(), disabled by default
+ * @arg ttl [Mandatory] time in ms a value is reused without asking the server,
+ * 0 disables the cache
+ * @arg stale_time [Optional] time in ms after the ttl during which the old
+ * value is still returned, the value is fetched again in the next loop()
+ */
+
+void UbiProtocolHandler::setCacheTtl(unsigned long ttl, unsigned long stale_time) { _cache.setTtl(ttl, stale_time); }
+
+/**
+ * Fetches again one stale value served by the cache
+ */
+
+void UbiProtocolHandler::_revalidateCache() {
+  const char *device_label;
+  const char *variable_label;
+  if (!_cache.pendingRevalidation(&device_label, &variable_label)) {
+    return;
+  }
+  double value = _fetch(device_label, variable_label);
+  if (value != ERROR_VALUE) {
+    _cache.store(device_label, variable_label, value);
+  }
+}
+
+/**
+ * Retrieves a last value from the server, through the healthiest transport
+ * that supports it if failover is enabled
+ */
+
+double UbiProtocolHandler::_fetch(const char *device_label, const char *variable_label) {
+  char text[UBI_LAST_VALUE_SIZE];
+  if (!_fetchText(device_label, variable_label, text, sizeof(text))) {
+    return ERROR_VALUE;
+  }
+  return strtod(text, NULL);
+}
+
+/**
+ * Reads the last value as the server wrote it, through the failover
+ * transports when they are enabled
+ */
+
+bool UbiProtocolHandler::_fetchText(const char *device_label, const char *variable_label, char *text, size_t size) {
+  if (!_failover.active()) {
+    return _ubiProtocol->getText(device_label, variable_label, text, size);
+  }
+
+  bool result = false;
+  uint8_t tried = 0;
+  IotProtocol transport;
+  while (_failover.select(UBI_OPERATION_GET, tried, &transport)) {
+    tried |= 1 << transport;
+    unsigned long start = millis();
+    result = _transports[transport]->getText(device_label, variable_label, text, size);
+    _failover.report(transport, result, millis() - start);
+    if (result) {
+      _lastTransport = transport;
+      break;
     }
+  }
+  return result;
+}
 
-    // Adds dot context
-    if ((_dots + i)->dot_context != NULL) {
-      sprintf(payload, "%s,\"context\": {%s}", payload, (_dots + i)->dot_context);
+/**
+ * Asks the server for a last value, within the rate limits, and refreshes the
+ * cache with it
+ */
+
+bool UbiProtocolHandler::_getText(const char *device_label, const char *variable_label, char *text, size_t size) {
+  if (_iot_protocol == UBI_UDP && !_failover.active()) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("ERROR, data retrieval is only supported using TCP or HTTP protocols"));
+    }
+    return false;
+  }
+
+  if (!_limiter.acquire(0, millis())) {
+    _trace.record(UBI_TRACE_THROTTLED, 0, _limiter.holdRemaining(millis()));
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("Rate limit reached, the value can not be retrieved now"));
+    }
+    return false;
+  }
+
+  _trace.record(UBI_TRACE_GET_BEGIN);
+  bool result = _fetchText(device_label, variable_label, text, size);
+  _trace.record(UBI_TRACE_GET_END, result);
+  if (!result) {
+    return false;
+  }
+
+  char *end;
+  double value = strtod(text, &end);
+  if (end == text) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] The last value is not a number"));
+    }
+    return false;
+  }
+  _cache.store(device_label, variable_label, value);
+  return true;
+}
+
+/**
+ * Failover mode: adds a transport that send() and get() use when it is
+ * healthier than the one set in the constructor, or when that one fails.
+ * Transports that keep failing are probed again from loop().
+ * @arg iot_protocol [Mandatory] transport to add
+ */
+
+bool UbiProtocolHandler::addFailover(IotProtocol iot_protocol) {
+  if (iot_protocol >= NUMBER_OF_SUPPORTED_PROTOCOLS) {
+    return false;
+  }
+  _transport(iot_protocol);
+  _failover.enable(_iot_protocol);
+  _failover.enable(iot_protocol);
+  return true;
+}
+
+/**
+ * @return the transport of the protocol, built the first time it is used
+ */
+
+UbiProtocol *UbiProtocolHandler::_transport(IotProtocol iot_protocol) {
+  if (_transports[iot_protocol] == NULL) {
+    UbiBuilder builder(_server, _token, iot_protocol);
+    _transports[iot_protocol] = builder.builder();
+    _configureTransport(_transports[iot_protocol]);
+  }
+  return _transports[iot_protocol];
+}
+
+/**
+ * Probes one down transport, if its probe interval has elapsed
+ */
+
+void UbiProtocolHandler::_probeTransports() {
+  IotProtocol transport;
+  if (!_failover.probeDue(&transport)) {
+    return;
+  }
+  unsigned long start = millis();
+  bool reachable = _transports[transport]->probe();
+  _failover.report(transport, reachable, millis() - start);
+  if (UBI_LOG_INFO) {
+    Serial.print(F("Probed protocol "));
+    Serial.print(transport);
+    Serial.println(reachable ? F(": up") : F(": down"));
+  }
+}
+
+void UbiProtocolHandler::_configureTransport(UbiProtocol *transport) {
+  transport->setClock(&_clock);
+  transport->setTrace(&_trace);
+  transport->setDebug(_debug);
+  transport->setConnectionPool(_pool);
+}
+
+/**
+ * Shares the TLS connections with the other instances attached to the same
+ * pool. Only TCP and HTTP requests take their connections from the pool.
+ */
+
+void UbiProtocolHandler::setConnectionPool(UbiConnectionPool *pool) {
+  _pool = pool;
+  for (uint8_t i = 0; i < NUMBER_OF_SUPPORTED_PROTOCOLS; i++) {
+    if (_transports[i] != NULL) {
+      _transports[i]->setConnectionPool(pool);
+    }
+  }
+}
+
+/**
+ * Client side rate limits, disabled by default. send() does not send while a
+ * limit is reached and keeps the dots for the next batch, get() fails. The
+ * Retry-After header of a 429 or 503 answer holds every request for the time
+ * asked by the server.
+ * @arg requests_per_minute [Mandatory] sustained requests, 0 for no limit
+ * @arg request_burst [Mandatory] requests that can be made at once
+ * @arg dots_per_second [Mandatory] sustained dots, 0 for no limit
+ * @arg dot_burst [Mandatory] dots that can be sent at once
+ */
+
+void UbiProtocolHandler::setRateLimit(uint16_t requests_per_minute, uint16_t request_burst, uint16_t dots_per_second,
+                                      uint16_t dot_burst) {
+  _limiter.setRequestRate(requests_per_minute, request_burst);
+  _limiter.setDotRate(dots_per_second, dot_burst);
+}
+
+/**
+ * Pipelined mode, only supported using TCP. While it is active, send() and
+ * getPipelined() queue frames on a single socket and their answers are
+ * reported through the callback in the same order.
+ */
+
+bool UbiProtocolHandler::beginPipeline(UbiPipelineCallback callback) {
+  if (_iot_protocol != UBI_TCP) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("ERROR, pipelined requests are only supported using TCP"));
+    }
+    return false;
+  }
+  if (_frameDots == NULL) {
+    _frameDots = (PipelinedDot *)malloc(UBI_PIPELINE_DEPTH * MAX_VALUES * sizeof(PipelinedDot));
+    if (_frameDots == NULL) {
+      return false;
+    }
+  }
+  _framesHead = 0;
+  _framesCount = 0;
+  UbiTCP *tcp = static_cast<UbiTCP *>(_ubiProtocol);
+  tcp->setPipelineListener(_onFrameAnswered, this);
+  return tcp->beginPipeline(callback);
+}
+
+bool UbiProtocolHandler::getPipelined(const char *device_label, const char *variable_label) {
+  if (_iot_protocol != UBI_TCP) {
+    return false;
+  }
+  if (!static_cast<UbiTCP *>(_ubiProtocol)->pipelineGet(device_label, variable_label)) {
+    return false;
+  }
+  _pushFrame(device_label, NULL, 0);
+  return true;
+}
+
+uint8_t UbiProtocolHandler::pollPipeline() {
+  if (_iot_protocol != UBI_TCP) {
+    return 0;
+  }
+  return static_cast<UbiTCP *>(_ubiProtocol)->pollPipeline();
+}
+
+/**
+ * Requests that can be queued without waiting for an answer, so a loop that
+ * drives several sessions never blocks in send() or getPipelined()
+ */
+
+uint8_t UbiProtocolHandler::pipelineSlots() {
+  if (_iot_protocol != UBI_TCP) {
+    return 0;
+  }
+  return static_cast<UbiTCP *>(_ubiProtocol)->pipelineSlots();
+}
+
+/**
+ * Tells if send() only queues its frame, the answer comes later through the
+ * pipeline callback
+ */
+
+bool UbiProtocolHandler::pipelined() {
+  return _iot_protocol == UBI_TCP && static_cast<UbiTCP *>(_ubiProtocol)->pipelined();
+}
+
+bool UbiProtocolHandler::endPipeline() {
+  if (_iot_protocol != UBI_TCP) {
+    return false;
+  }
+  return static_cast<UbiTCP *>(_ubiProtocol)->endPipeline();
+}
+
+/**
+ * Historical values, read through HTTP whatever the protocol set in the
+ * constructor is. The values are streamed page by page by nextValue().
+ */
+
+bool UbiProtocolHandler::beginValues(const char *device_label, const char *variable_label, uint16_t count,
+                                     uint64_t start, uint64_t end) {
+  return static_cast<UbiHTTP *>(_transport(UBI_HTTP))->beginValues(device_label, variable_label, count, start, end);
+}
+
+bool UbiProtocolHandler::nextValue(UbiHistoricalValue *value) {
+  if (_transports[UBI_HTTP] == NULL) {
+    return false;
+  }
+  return static_cast<UbiHTTP *>(_transports[UBI_HTTP])->nextValue(value);
+}
+
+void UbiProtocolHandler::endValues() {
+  if (_transports[UBI_HTTP] != NULL) {
+    static_cast<UbiHTTP *>(_transports[UBI_HTTP])->endValues();
+  }
+}
+
+/**
+ * Variable subscriptions, only supported using MQTT. The callback is called
+ * from loop() every time the variable gets a new dot. loop() also refreshes
+ * the stale values served by the last value cache.
+ */
+
+bool UbiProtocolHandler::subscribe(const char *device_label, const char *variable_label,
+                                   UbiSubscribeCallback callback) {
+  if (_iot_protocol != UBI_MQTT) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("ERROR, subscriptions are only supported using MQTT"));
     }
+    return false;
+  }
+  return static_cast<UbiMQTT *>(_ubiProtocol)->subscribe(device_label, variable_label, callback);
+}
+
+bool UbiProtocolHandler::loop() {
+  _revalidateCache();
+  _probeTransports();
+  _trace.drain();
+  if (_iot_protocol != UBI_MQTT) {
+    return true;
+  }
+  return static_cast<UbiMQTT *>(_ubiProtocol)->loop();
+}
+
+void UbiProtocolHandler::setQos(uint8_t qos) {
+  if (_iot_protocol == UBI_MQTT) {
+    static_cast<UbiMQTT *>(_ubiProtocol)->setQos(qos);
+  }
+}
 
-    sprintf(payload, "%s}", payload);
-    i++;
+/**
+ * Writes the value of a dot in its type, integers without going through
+ * printf
+ * @return number of characters written, without the null terminator
+ */
 
-    if (i < _current_value) {
-      sprintf(payload, "%s,", payload);
+uint8_t UbiProtocolHandler::_writeValue(char *str_value, const Value *dot) {
+  uint8_t length;
+  switch (dot->value_type) {
+  case UBI_VALUE_INT:
+    length = UbiUtils::signedToChar(str_value, dot->dot_int);
+    break;
+  case UBI_VALUE_FIXED:
+    length = UbiUtils::fixedToChar(str_value, dot->dot_int, dot->value_scale);
+    break;
+  case UBI_VALUE_DOUBLE:
+    return UbiUtils::doubleToChar(str_value, dot->dot_double);
+  default:
+    UbiUtils::floatToChar(str_value, dot->dot_value);
+    return strlen(str_value);
+  }
+  str_value[length] = '\0';
+  return length;
+}
+
+/**
+ * Builds the HTTP payload to send and saves it to the input char pointer.
+ * The dots of a variable added several times are written in an array under a
+ * single label, {"label":[{...},{...}]}, as the server keeps only one of
+ * repeated keys; they are first moved next to each other in the batch, so the
+ * payload keeps the order of the batch.
+ * @payload [Mandatory] char payload pointer to store the built structure.
+ * @return the number of dots that fit in MAX_BUFFER_SIZE
+ */
+
+uint8_t UbiProtocolHandler::buildHttpPayload(char *payload, Value *dots, uint8_t dots_count) {
+  _groupByLabel(dots, dots_count);
+
+  // Room kept to close an open array and the object
+  const size_t reserved = 2;
+  size_t length = _appendf(payload, 0, reserved, "{");
+  uint8_t written = 0;
+  bool inSeries = false;
+  for (; written < dots_count; written++) {
+    const Value *dot = dots + written;
+    bool first = written == 0 || strcmp((dot - 1)->variable_label, dot->variable_label) != 0;
+    bool last = written + 1 == dots_count || strcmp((dot + 1)->variable_label, dot->variable_label) != 0;
+    size_t start = length;
+    if (first) {
+      length = _appendf(payload, length, reserved, "%s\"%s\":%s", written > 0 ? "," : "", dot->variable_label,
+                        last ? "" : "[");
     } else {
-      sprintf(payload, "%s}", payload);
-      _current_value = 0;
+      length = _appendf(payload, length, reserved, ",");
+    }
+    length = _writeHttpDot(payload, length, reserved, dot);
+    if (!first && last) {
+      length = _appendf(payload, length, reserved, "]");
+    }
+    if (length >= MAX_BUFFER_SIZE - reserved) {
+      length = start;
+      payload[length] = '\0';
+      break;
     }
+    inSeries = !last;
   }
+  strcpy(payload + length, inSeries ? "]}" : "}");
 
-  if (_debug) {
-    Serial.println("----------");
-    Serial.println("payload:");
+  if (UBI_LOG_DEBUG) {
+    Serial.println(F("----------"));
+    Serial.println(F("payload:"));
     Serial.println(payload);
-    Serial.println("----------");
-    Serial.println("");
+    Serial.println(F("----------"));
+    Serial.println(F(""));
+  }
+  return written;
+}
+
+/**
+ * Moves the dots of every variable next to its first dot, keeping the order
+ * of the variables and of the dots of each one
+ */
+
+void UbiProtocolHandler::_groupByLabel(Value *dots, uint8_t dots_count) {
+  for (uint8_t i = 0; i < dots_count;) {
+    uint8_t end = i + 1;
+    for (uint8_t j = end; j < dots_count; j++) {
+      if (strcmp((dots + j)->variable_label, (dots + i)->variable_label) != 0) {
+        continue;
+      }
+      if (j != end) {
+        Value dot = *(dots + j);
+        memmove(dots + end + 1, dots + end, (j - end) * sizeof(Value));
+        *(dots + end) = dot;
+      }
+      end++;
+    }
+    i = end;
   }
 }
 
+/**
+ * Appends the object of a dot to the HTTP payload: its value, timestamp and
+ * context
+ * @return the new length, see _appendf()
+ */
+
+size_t UbiProtocolHandler::_writeHttpDot(char *payload, size_t length, size_t reserved, const Value *dot) {
+  char str_value[UBI_VALUE_STRING_SIZE];
+  _writeValue(str_value, dot);
+  length = _appendf(payload, length, reserved, "{\"value\":%s", str_value);
+
+  // Adds timestamp
+  if (dot->dot_timestamp != 0) {
+    char timestamp[21];
+    timestamp[UbiUtils::unsignedToChar(timestamp, dot->dot_timestamp)] = '\0';
+    length = _appendf(payload, length, reserved, ",\"timestamp\":%s", timestamp);
+  }
+
+  // Adds dot context
+  if (dot->dot_context != NULL) {
+    length = _appendf(payload, length, reserved, ",\"context\": {%s}", dot->dot_context);
+  } else if (dot->dot_context_ref != NULL) {
+    // Encoded once and reused by every dot the context is attached to
+    length = _appendf(payload, length, reserved, ",\"context\":{%s}", dot->dot_context_ref->encoded(UBI_HTTP));
+  }
+
+  return _appendf(payload, length, reserved, "}");
+}
+
 /**
  * Builds the TCP payload to send and saves it to the input char pointer.
  * @payload [Mandatory] char payload pointer to store the built structure.
- * @timestamp_global [Optional] If set, it will be used for any dot without
- * timestamp.
+ * @return the number of dots that fit in MAX_BUFFER_SIZE
  */
 
-void UbiProtocolHandler::buildTcpPayload(char *payload, const char *device_label, const char *device_name) {
-  sprintf(payload, "");
-  sprintf(payload, "%s|POST|%s|", USER_AGENT, _token);
-  sprintf(payload, "%s%s:%s", payload, device_label, device_name);
-
-  sprintf(payload, "%s=>", payload);
-  for (uint8_t i = 0; i < _current_value;) {
-    char str_value[20];
-    UbiUtils::floatToChar(str_value, (_dots + i)->dot_value);
-    sprintf(payload, "%s%s:%s", payload, (_dots + i)->variable_label, str_value);
+uint8_t UbiProtocolHandler::buildTcpPayload(char *payload, const Value *dots, uint8_t dots_count,
+                                            const char *device_label, const char *device_name) {
+  // Room kept for the "|end" terminator
+  const size_t reserved = 4;
+  size_t length = _appendf(payload, 0, reserved, "%s|POST|%s|%s:%s=>", USER_AGENT, _token, device_label, device_name);
+  uint8_t written = 0;
+  for (; written < dots_count && length < MAX_BUFFER_SIZE - reserved; written++) {
+    const Value *dot = dots + written;
+    size_t start = length;
+    char str_value[UBI_VALUE_STRING_SIZE];
+    _writeValue(str_value, dot);
+    length = _appendf(payload, length, reserved, "%s%s:%s", written > 0 ? "," : "", dot->variable_label, str_value);
 
     // Adds dot context
-    if ((_dots + i)->dot_context != NULL) {
-      sprintf(payload, "%s$%s", payload, (_dots + i)->dot_context);
-    }
-
-    // Adds timestamp seconds
-    if ((_dots + i)->dot_timestamp_seconds != NULL) {
-      sprintf(payload, "%s@%lu", payload, (_dots + i)->dot_timestamp_seconds);
-      // Adds timestamp milliseconds
-      if ((_dots + i)->dot_timestamp_millis != NULL) {
-        char milliseconds[3];
-        int timestamp_millis = (_dots + i)->dot_timestamp_millis;
-        uint8_t units = timestamp_millis % 10;
-        uint8_t dec = (timestamp_millis / 10) % 10;
-        uint8_t hund = (timestamp_millis / 100) % 10;
-        sprintf(milliseconds, "%d%d%d", hund, dec, units);
-        sprintf(payload, "%s%s", payload, milliseconds);
-      } else {
-        sprintf(payload, "%s000", payload);
-      }
+    if (dot->dot_context != NULL) {
+      length = _appendf(payload, length, reserved, "$%s", dot->dot_context);
+    } else if (dot->dot_context_ref != NULL && dot->dot_context_ref->size() > 0) {
+      length = _appendf(payload, length, reserved, "$%s", dot->dot_context_ref->encoded(UBI_TCP));
     }
 
-    i++;
+    // Adds timestamp
+    if (dot->dot_timestamp != 0) {
+      char timestamp[21];
+      timestamp[UbiUtils::unsignedToChar(timestamp, dot->dot_timestamp)] = '\0';
+      length = _appendf(payload, length, reserved, "@%s", timestamp);
+    }
 
-    if (i < _current_value) {
-      sprintf(payload, "%s,", payload);
-    } else {
-      sprintf(payload, "%s|end", payload);
-      _current_value = 0;
+    if (length >= MAX_BUFFER_SIZE - reserved) {
+      length = start;
+      payload[length] = '\0';
+      break;
     }
   }
+  strcpy(payload + length, "|end");
 
-  if (_debug) {
-    Serial.println("----------");
-    Serial.println("payload:");
+  if (UBI_LOG_DEBUG) {
+    Serial.println(F("----------"));
+    Serial.println(F("payload:"));
     Serial.println(payload);
-    Serial.println("----------");
-    Serial.println("");
+    Serial.println(F("----------"));
+    Serial.println(F(""));
   }
+  return written;
 }
 
 /*
@@ -254,7 +1263,11 @@ void UbiProtocolHandler::buildTcpPayload(char *payload, const char *device_label
 
 void UbiProtocolHandler::setDebug(bool debug) {
   _debug = debug;
-  _ubiProtocol->setDebug(debug);
+  for (uint8_t i = 0; i < NUMBER_OF_SUPPORTED_PROTOCOLS; i++) {
+    if (_transports[i] != NULL) {
+      _transports[i]->setDebug(debug);
+    }
+  }
 }
 
 bool UbiProtocolHandler::serverConnected() { return _ubiProtocol->serverConnected(); }
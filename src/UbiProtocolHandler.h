@@ -26,31 +26,154 @@ Inc
 #define _UbiProtocolHandler_H_
 
 #include "UbiBuilder.h"
+#include "UbiClock.h"
+#include "UbiContext.h"
+#include "UbiFailover.h"
+#include "UbiHttp.h"
+#include "UbiLatencyStats.h"
+#include "UbiLog.h"
+#include "UbiMqtt.h"
+#include "UbiRateLimiter.h"
+#include "UbiValueCache.h"
+#include "UbiTcp.h"
+#include "UbiTrace.h"
 
 class UbiProtocolHandler {
 public:
   explicit UbiProtocolHandler(const char *token, IotProtocol iot_protocol);
   explicit UbiProtocolHandler(const char *token, UbiServer server = UBI_INDUSTRIAL, IotProtocol iot_protocol = UBI_TCP);
   void add(const char *variable_label, float value, char *context, unsigned long dot_timestamp_seconds,
-           unsigned int dot_timestamp_millis);
+           unsigned int dot_timestamp_millis, UbiPriority priority = UBI_PRIORITY_NORMAL);
+  void add(const char *variable_label, float value, const UbiContext *context, unsigned long dot_timestamp_seconds,
+           unsigned int dot_timestamp_millis, UbiPriority priority = UBI_PRIORITY_NORMAL);
+  void addInt(const char *variable_label, int64_t value, const UbiContext *context, unsigned long dot_timestamp_seconds,
+              unsigned int dot_timestamp_millis, UbiPriority priority = UBI_PRIORITY_NORMAL);
+  void addFixed(const char *variable_label, int64_t value, uint8_t decimals, const UbiContext *context,
+                unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis,
+                UbiPriority priority = UBI_PRIORITY_NORMAL);
+  void addDouble(const char *variable_label, double value, const UbiContext *context,
+                 unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis,
+                 UbiPriority priority = UBI_PRIORITY_NORMAL);
+  void addValue(const char *variable_label, const UbiTypedValue &value, const UbiContext *context,
+                uint64_t dot_timestamp, UbiPriority priority = UBI_PRIORITY_NORMAL);
+  uint8_t pendingDots() const { return _current_value; }
   bool send(const char *device_label, const char *device_name);
   double get(const char *device_label, const char *variable_label);
+  bool getInt(const char *device_label, const char *variable_label, int64_t *value);
+  bool getFixed(const char *device_label, const char *variable_label, uint8_t decimals, int64_t *value);
+  bool getDouble(const char *device_label, const char *variable_label, double *value);
   void setDebug(bool debug);
   bool serverConnected();
+  bool beginPipeline(UbiPipelineCallback callback);
+  bool getPipelined(const char *device_label, const char *variable_label);
+  uint8_t pollPipeline();
+  uint8_t pipelineSlots();
+  bool pipelined();
+  bool endPipeline();
+  bool beginValues(const char *device_label, const char *variable_label, uint16_t count, uint64_t start,
+                   uint64_t end);
+  bool nextValue(UbiHistoricalValue *value);
+  void endValues();
+  bool subscribe(const char *device_label, const char *variable_label, UbiSubscribeCallback callback);
+  bool loop();
+  void setQos(uint8_t qos);
+  void setCacheTtl(unsigned long ttl, unsigned long stale_time);
+  const UbiValueCache &cache() const { return _cache; }
+  void setRetryPolicy(uint8_t max_retries, unsigned long retry_budget);
+  uint32_t lastBatchId() const { return _batchId; }
+  void setAutoTimestamp(bool auto_timestamp);
+  UbiClock &clock() { return _clock; }
+  bool flushDue();
+  void setBulkThresholds(uint8_t max_dots, unsigned long max_age, uint16_t max_bytes);
+  const UbiLatencyStats &latencyStats(UbiPriority priority) const { return _latency[priority]; }
+  bool setTrace(Print *output);
+  const UbiTrace &trace() const { return _trace; }
+  bool addFailover(IotProtocol iot_protocol);
+  const UbiFailover &failover() const { return _failover; }
+  IotProtocol lastTransport() const { return _lastTransport; }
+  void setConnectionPool(UbiConnectionPool *pool);
+  void setRateLimit(uint16_t requests_per_minute, uint16_t request_burst, uint16_t dots_per_second,
+                    uint16_t dot_burst);
+  const UbiRateLimiter &rateLimiter() const { return _limiter; }
   virtual ~UbiProtocolHandler();
 
 private:
-  int8_t _current_value = 0;
+  // Dots of a pipelined frame, accounted for when the frame is answered
+  typedef struct PipelinedDot {
+    const char *variable_label;
+    unsigned long added_at;
+    uint8_t priority;
+  } PipelinedDot;
+
+  // The device label is copied, send() does not need it once it returned
+  typedef struct PipelinedFrame {
+    char device_label[UBI_CACHE_LABEL_SIZE];
+    uint8_t dots;
+  } PipelinedFrame;
+
+  volatile uint8_t _current_value = 0;
+  // Dots that found the buffer full, logged by the next send()
+  volatile uint16_t _overflowedDots = 0;
   int _connectionTimeout = 5000;
 
   UbiProtocol *_ubiProtocol;
   IotProtocol _iot_protocol;
-  Value *_dots;
+  Value *_dotBuffers[2];
+  Value *volatile _dots;
+  uint8_t _activeBuffer = 0;
   const char *_token;
-  bool _debug;
+  bool _debug = UBI_DEBUG_DEFAULT;
+  UbiValueCache _cache;
+
+  uint8_t _maxRetries = 0;
+  unsigned long _retryBudget = 0;
+  uint32_t _batchId = 0;
+  UbiClock _clock;
+  bool _autoTimestamp = true;
+  uint8_t _bulkMaxDots = MAX_VALUES;
+  unsigned long _bulkMaxAge = 60000;
+  uint16_t _bulkMaxBytes = MAX_BUFFER_SIZE * 3 / 4;
+  UbiLatencyStats _latency[NUMBER_OF_PRIORITIES];
+  UbiTrace _trace;
+  UbiServer _server;
+  UbiProtocol *_transports[NUMBER_OF_SUPPORTED_PROTOCOLS] = {NULL};
+  UbiFailover _failover;
+  UbiRateLimiter _limiter;
+  IotProtocol _lastTransport;
+  UbiConnectionPool *_pool = NULL;
+  PipelinedFrame _frames[UBI_PIPELINE_DEPTH];
+  PipelinedDot *_frameDots = NULL;
+  uint8_t _framesHead = 0;
+  uint8_t _framesCount = 0;
 
-  void buildHttpPayload(char *payload);
-  void buildTcpPayload(char *payload, const char *device_label, const char *device_name);
+  static uint8_t _writeValue(char *str_value, const Value *dot);
+  void _addDot(const char *variable_label, const Value &value, char *context, const UbiContext *context_ref,
+               uint64_t dot_timestamp, UbiPriority priority);
+  static uint64_t _toTimestamp(unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis);
+  void _revalidateCache();
+  uint8_t _buildPayload(char *payload, IotProtocol iot_protocol, Value *dots, uint8_t dots_count,
+                        const char *device_label, const char *device_name);
+  static size_t _appendf(char *payload, size_t length, size_t reserved, const char *format, ...);
+  bool _sendWithFailover(char *payload, Value *dots, uint8_t dots_count, const char *device_label,
+                         const char *device_name, uint8_t *sent);
+  bool _sendWithRetries(IotProtocol iot_protocol, const char *device_label, const char *device_name, char *payload);
+  double _fetch(const char *device_label, const char *variable_label);
+  bool _fetchText(const char *device_label, const char *variable_label, char *text, size_t size);
+  bool _getText(const char *device_label, const char *variable_label, char *text, size_t size);
+  void _probeTransports();
+  void _configureTransport(UbiProtocol *transport);
+  UbiProtocol *_transport(IotProtocol iot_protocol);
+  void _requeue(const Value *batch, uint8_t dots_count);
+  void _stampDots(Value *dots, uint8_t dots_count);
+  void _acknowledge(const char *device_label, const Value *dots, uint8_t dots_count);
+  void _pushFrame(const char *device_label, const Value *dots, uint8_t dots_count);
+  static void _onFrameAnswered(void *context, bool success);
+  uint8_t _partitionFailedDots(Value *batch, uint8_t dots_count, uint8_t *rejected);
+  uint8_t buildHttpPayload(char *payload, Value *dots, uint8_t dots_count);
+  static void _groupByLabel(Value *dots, uint8_t dots_count);
+  size_t _writeHttpDot(char *payload, size_t length, size_t reserved, const Value *dot);
+  uint8_t buildTcpPayload(char *payload, const Value *dots, uint8_t dots_count, const char *device_label,
+                          const char *device_name);
   void _builder(const char *token, UbiServer server, IotProtocol iot_protocol);
   void _getDeviceMac(char macAdrr[]);
 };
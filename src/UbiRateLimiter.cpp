@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiRateLimiter.h"
+
+namespace {
+
+const uint32_t TOKEN = 1000;
+
+}  // namespace
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiRateLimiter::UbiRateLimiter() : _lastRefill(0), _holdUntil(0), _holding(false), _throttled(0) {
+  _configure(&_requests, 0, 0);
+  _configure(&_dots, 0, 0);
+}
+
+/**************************************************************************
+ * Limits
+ ***************************************************************************/
+
+/**
+ * @arg requests_per_minute [Mandatory] sustained request rate, 0 for no limit
+ * @arg burst [Mandatory] requests that can be made at once after an idle time
+ */
+
+void UbiRateLimiter::setRequestRate(uint16_t requests_per_minute, uint16_t burst) {
+  _configure(&_requests, (uint32_t)requests_per_minute * TOKEN / 60, burst);
+}
+
+/**
+ * @arg dots_per_second [Mandatory] sustained dot rate, 0 for no limit
+ * @arg burst [Mandatory] dots that can be sent at once after an idle time
+ */
+
+void UbiRateLimiter::setDotRate(uint16_t dots_per_second, uint16_t burst) {
+  _configure(&_dots, (uint32_t)dots_per_second * TOKEN, burst);
+}
+
+void UbiRateLimiter::_configure(TokenBucket *bucket, uint32_t rate, uint16_t burst) {
+  bucket->rate = rate;
+  bucket->capacity = (uint32_t)(burst > 0 ? burst : 1) * TOKEN;
+  bucket->tokens = bucket->capacity;
+  bucket->remainder = 0;
+}
+
+/**
+ * Takes a request token and a token per dot if both buckets have them
+ * @arg dots [Mandatory] dots of the batch, a batch larger than the dot burst
+ * costs the whole burst
+ * @return false if the request has to wait, no token is taken then
+ */
+
+bool UbiRateLimiter::acquire(uint8_t dots, unsigned long now) {
+  unsigned long elapsed = now - _lastRefill;
+  _lastRefill = now;
+  _refill(&_requests, elapsed);
+  _refill(&_dots, elapsed);
+  // An expired hold is forgotten, 24.8 days later the difference would read as positive again
+  if (_holding && holdRemaining(now) == 0) {
+    _holding = false;
+  }
+
+  uint32_t dotCost = (uint32_t)dots * TOKEN;
+  if (dotCost > _dots.capacity) {
+    dotCost = _dots.capacity;
+  }
+  bool allowed = !_holding && (_requests.rate == 0 || _requests.tokens >= TOKEN) &&
+                 (_dots.rate == 0 || _dots.tokens >= dotCost);
+  if (!allowed) {
+    _throttled++;
+    return false;
+  }
+  if (_requests.rate > 0) {
+    _requests.tokens -= TOKEN;
+  }
+  if (_dots.rate > 0) {
+    _dots.tokens -= dotCost;
+  }
+  return true;
+}
+
+/**
+ * Stops every request for a while, e.g. as asked by the Retry-After header of
+ * a 429 or 503 answer
+ * @arg duration [Mandatory] time to wait in milliseconds
+ */
+
+void UbiRateLimiter::holdFor(unsigned long duration, unsigned long now) {
+  unsigned long until = now + duration;
+  if (!_holding || (long)(until - _holdUntil) > 0) {
+    _holdUntil = until;
+  }
+  _holding = true;
+}
+
+unsigned long UbiRateLimiter::holdRemaining(unsigned long now) const {
+  if (!_holding) {
+    return 0;
+  }
+  long remaining = (long)(_holdUntil - now);
+  return remaining > 0 ? remaining : 0;
+}
+
+void UbiRateLimiter::_refill(TokenBucket *bucket, unsigned long elapsed) {
+  if (bucket->rate == 0) {
+    return;
+  }
+  // Thousandths of a token per second times milliseconds gives millionths, the rest is kept for the next refill
+  uint64_t millionths = (uint64_t)elapsed * bucket->rate + bucket->remainder;
+  bucket->remainder = millionths % TOKEN;
+  uint64_t tokens = bucket->tokens + millionths / TOKEN;
+  bucket->tokens = tokens < bucket->capacity ? tokens : bucket->capacity;
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiRateLimiter_H_
+#define _UbiRateLimiter_H_
+
+#include "UbiConstants.h"
+
+/**
+ * Client side limits on the requests and the dots sent per second, as two
+ * token buckets, plus a hold set from the Retry-After header of the server.
+ * Tokens are kept in thousandths so that rates below one per second work with
+ * integer arithmetic. A rate of 0 disables its bucket.
+ */
+
+class UbiRateLimiter {
+public:
+  UbiRateLimiter();
+  void setRequestRate(uint16_t requests_per_minute, uint16_t burst);
+  void setDotRate(uint16_t dots_per_second, uint16_t burst);
+  bool acquire(uint8_t dots, unsigned long now);
+  void holdFor(unsigned long duration, unsigned long now);
+  unsigned long holdRemaining(unsigned long now) const;
+  uint32_t throttled() const { return _throttled; }
+
+private:
+  typedef struct TokenBucket {
+    // Thousandths of a token added per second
+    uint32_t rate;
+    uint32_t capacity;
+    uint32_t tokens;
+    uint32_t remainder;
+  } TokenBucket;
+
+  TokenBucket _requests;
+  TokenBucket _dots;
+  unsigned long _lastRefill;
+  unsigned long _holdUntil;
+  bool _holding;
+  uint32_t _throttled;
+
+  void _refill(TokenBucket *bucket, unsigned long elapsed);
+  static void _configure(TokenBucket *bucket, uint32_t rate, uint16_t burst);
+};
+
+#endif
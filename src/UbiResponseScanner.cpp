@@ -0,0 +1,152 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiResponseScanner.h"
+
+#include "UbiUtils.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiResponseScanner::UbiResponseScanner() { reset(); }
+
+void UbiResponseScanner::reset() {
+  _count = 0;
+  _depth = 0;
+  _inString = false;
+  _escaped = false;
+  _haveString = false;
+  _stringHash = UbiUtils::FNV_OFFSET_BASIS;
+  _readingStatus = false;
+  _haveDigits = false;
+  _number = 0;
+  _haveLabel = false;
+  _labelHash = 0;
+  _index = -1;
+}
+
+/**************************************************************************
+ * Scanner
+ ***************************************************************************/
+
+void UbiResponseScanner::feed(char c) {
+  if (_inString) {
+    if (_escaped) {
+      _escaped = false;
+      _stringHash = UbiUtils::fnv1a(_stringHash, c);
+    } else if (c == '\\') {
+      _escaped = true;
+    } else if (c == '"') {
+      _inString = false;
+      _haveString = true;
+    } else {
+      _stringHash = UbiUtils::fnv1a(_stringHash, c);
+    }
+    return;
+  }
+
+  if (_readingStatus && c >= '0' && c <= '9') {
+    _number = _number * 10 + (c - '0');
+    _haveDigits = true;
+    return;
+  }
+  if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+    if (_haveDigits) {
+      _endNumber();
+    }
+    return;
+  }
+  _endNumber();
+
+  switch (c) {
+  case '"':
+    _inString = true;
+    _haveString = false;
+    _stringHash = UbiUtils::FNV_OFFSET_BASIS;
+    break;
+  case ':':
+    if (!_haveString) {
+      break;
+    }
+    if (_depth == 1) {
+      _haveLabel = true;
+      _labelHash = _stringHash;
+      _index = -1;
+    } else if (_depth == 3 && _haveLabel && _stringHash == UbiUtils::fnv1a("status_code")) {
+      _readingStatus = true;
+      _haveDigits = false;
+      _number = 0;
+    }
+    _haveString = false;
+    break;
+  case '{':
+    // Every object of the array of a key is the answer to one of its dots
+    if (_depth == 2) {
+      _index++;
+    }
+    _depth++;
+    break;
+  case '[':
+    _depth++;
+    break;
+  case '}':
+  case ']':
+    _depth--;
+    break;
+  case ',':
+    _haveString = false;
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @arg index [Mandatory] position of the dot among the dots of the variable
+ * @return status code the server gave to the dot, 0 if it is not in the answer
+ */
+
+int16_t UbiResponseScanner::status(const char *variable_label, uint8_t index) const {
+  uint32_t labelHash = UbiUtils::fnv1a(variable_label);
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_dots[i].labelHash == labelHash && _dots[i].index == index) {
+      return _dots[i].status;
+    }
+  }
+  return 0;
+}
+
+void UbiResponseScanner::_endNumber() {
+  if (!_readingStatus) {
+    return;
+  }
+  if (_haveDigits && _index >= 0 && _count < MAX_VALUES) {
+    DotStatus *dot = _dots + _count++;
+    dot->labelHash = _labelHash;
+    dot->index = _index;
+    dot->status = _number;
+  }
+  _readingStatus = false;
+}
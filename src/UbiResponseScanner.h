@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiResponseScanner_H_
+#define _UbiResponseScanner_H_
+
+#include <Arduino.h>
+
+#include "UbiConstants.h"
+
+/**
+ * Streaming scanner of the JSON answer to a POST of several variables, e.g.
+ * {"temperature":[{"status_code":201},{"status_code":400}]}.
+ * The body is fed one character at a time, so it is never stored; only the
+ * status code of every dot is kept, with its key hashed and its index in the
+ * array of the key.
+ */
+
+class UbiResponseScanner {
+public:
+  UbiResponseScanner();
+  void reset();
+  void feed(char c);
+  uint8_t statuses() const { return _count; }
+  int16_t status(const char *variable_label, uint8_t index) const;
+
+private:
+  typedef struct DotStatus {
+    uint32_t labelHash;
+    uint8_t index;
+    int16_t status;
+  } DotStatus;
+
+  DotStatus _dots[MAX_VALUES];
+  uint8_t _count;
+
+  int8_t _depth;
+  bool _inString;
+  bool _escaped;
+  bool _haveString;
+  uint32_t _stringHash;
+  bool _readingStatus;
+  bool _haveDigits;
+  int16_t _number;
+  bool _haveLabel;
+  uint32_t _labelHash;
+  int16_t _index;
+
+  void _endNumber();
+};
+
+#endif
@@ -0,0 +1,465 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiSpool.h"
+
+#include <stddef.h>
+
+#include "UbiUtils.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiSpool::UbiSpool(Ubidots *ubidots) : _ubidots(ubidots) {}
+
+/**
+ * Opens the spool, finding the end of the log and the last acknowledged dot
+ * @arg storage [Mandatory] at least 2 segments of 128 bytes or more, it must
+ * be alive while the spool is used. A blank storage is formatted.
+ * @return false if the storage is too small or can not be written
+ */
+
+bool UbiSpool::begin(UbiSpoolStorage *storage) {
+  _storage = storage;
+  _slots = storage->segmentSize() / sizeof(UbiSpoolRecord);
+  uint8_t segments = storage->segments();
+  if (segments < 2 || _slots < 2) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] The spool needs at least 2 segments of 2 records"));
+    }
+    _storage = NULL;
+    return false;
+  }
+  _nextSequence = 1;
+  _committed = 0;
+  _backlog = 0;
+  _readCount = 0;
+  _batchCount = 0;
+  _retryPending = false;
+
+  // The newest segment is the head of the log, every segment keeps the
+  // committed sequence when it was opened, in case its commits were dropped
+  UbiSpoolRecord record;
+  int16_t newest = -1;
+  for (uint8_t segment = 0; segment < segments; segment++) {
+    if (!_readRecord(segment, 0, &record) || record.kind != UBI_SPOOL_SEGMENT) {
+      continue;
+    }
+    if (newest < 0 || record.sequence >= _nextSequence) {
+      newest = segment;
+      _nextSequence = record.sequence + 1;
+    }
+    if (record.timestamp > _committed) {
+      _committed = record.timestamp;
+    }
+  }
+  if (newest < 0) {
+    if (!_openSegment(0)) {
+      return false;
+    }
+    _tail = _head;
+    _read = _head;
+    _readSequence = 0;
+    return true;
+  }
+
+  // Segments are used in ring order, the oldest one follows the head
+  uint8_t oldest = newest;
+  for (uint8_t i = 1; i < segments; i++) {
+    uint8_t segment = (newest + i) % segments;
+    if (_readRecord(segment, 0, &record) && record.kind == UBI_SPOOL_SEGMENT) {
+      oldest = segment;
+      break;
+    }
+  }
+
+  _head.segment = newest;
+  _head.slot = _slots;
+  for (uint8_t segment = oldest;; segment = (segment + 1) % segments) {
+    for (uint16_t slot = 1; slot < _slots; slot++) {
+      if (!_readRecord(segment, slot, &record)) {
+        if (segment == newest && _blank(record)) {
+          _head.slot = slot;
+        }
+        // A torn record can not be written over, the next dot opens a new segment
+        break;
+      }
+      if (record.sequence >= _nextSequence) {
+        _nextSequence = record.sequence + 1;
+      }
+      if (record.kind == UBI_SPOOL_COMMIT && record.timestamp > _committed) {
+        _committed = record.timestamp;
+      }
+    }
+    if (segment == newest) {
+      break;
+    }
+  }
+
+  _tail = _head;
+  bool found = false;
+  Cursor cursor = {oldest, 1};
+  while (!_atHead(cursor)) {
+    if (_readRecord(cursor.segment, cursor.slot, &record) && record.kind == UBI_SPOOL_DOT &&
+        record.sequence > _committed) {
+      if (!found) {
+        _tail = cursor;
+        found = true;
+      }
+      _backlog++;
+    }
+    _next(&cursor);
+  }
+  _read = _tail;
+  _readSequence = _committed;
+  return true;
+}
+
+/**************************************************************************
+ * Dots
+ ***************************************************************************/
+
+/**
+ * Appends a dot to the spool
+ * @arg variable_label [Mandatory] up to 37 characters, it is copied
+ * @arg dot_timestamp [Optional] milliseconds since the epoch, by default the
+ * dot is stamped now, as it may be sent much later
+ * @return false if the dot could not be written
+ */
+
+bool UbiSpool::add(const char *variable_label, float value, uint64_t dot_timestamp) {
+  UbiSpoolRecord record;
+  if (!_prepare(&record, variable_label, UBI_VALUE_FLOAT, dot_timestamp)) {
+    return false;
+  }
+  record.dot_value = value;
+  return _addDot(&record);
+}
+
+bool UbiSpool::addInt(const char *variable_label, int64_t value, uint64_t dot_timestamp) {
+  UbiSpoolRecord record;
+  if (!_prepare(&record, variable_label, UBI_VALUE_INT, dot_timestamp)) {
+    return false;
+  }
+  record.dot_int = value;
+  return _addDot(&record);
+}
+
+bool UbiSpool::addFixed(const char *variable_label, int64_t value, uint8_t decimals, uint64_t dot_timestamp) {
+  UbiSpoolRecord record;
+  if (decimals > UBI_MAX_DECIMALS || !_prepare(&record, variable_label, UBI_VALUE_FIXED, dot_timestamp)) {
+    return false;
+  }
+  record.dot_int = value;
+  record.value_scale = decimals;
+  return _addDot(&record);
+}
+
+bool UbiSpool::addDouble(const char *variable_label, double value, uint64_t dot_timestamp) {
+  UbiSpoolRecord record;
+  if (!_prepare(&record, variable_label, UBI_VALUE_DOUBLE, dot_timestamp)) {
+    return false;
+  }
+  record.dot_double = value;
+  return _addDot(&record);
+}
+
+/**
+ * Reads the next dots that were not acknowledged, the read position is kept
+ * in memory only, until commit() or rewind() is called
+ * @arg records [Mandatory] array to store the dots
+ * @arg max_records [Mandatory] size of the array
+ * @return number of dots read, 0 once the end of the log is reached
+ */
+
+uint8_t UbiSpool::read(UbiSpoolRecord *records, uint8_t max_records) {
+  if (_storage == NULL) {
+    return 0;
+  }
+  uint8_t count = 0;
+  while (count < max_records && !_atHead(_read)) {
+    UbiSpoolRecord *record = &records[count];
+    if (_readRecord(_read.segment, _read.slot, record) && record->kind == UBI_SPOOL_DOT &&
+        record->sequence > _readSequence) {
+      _readSequence = record->sequence;
+      count++;
+    }
+    _next(&_read);
+  }
+  _readCount += count;
+  return count;
+}
+
+/**
+ * Moves the commit cursor past the dots read, once the server acknowledged them
+ * @return false if the commit record could not be written, the dots are then
+ * sent again after a reboot
+ */
+
+bool UbiSpool::commit() {
+  if (_readSequence <= _committed) {
+    return true;
+  }
+  UbiSpoolRecord record;
+  memset(&record, 0, sizeof(record));
+  record.kind = UBI_SPOOL_COMMIT;
+  record.timestamp = _readSequence;
+  if (!_append(&record)) {
+    return false;
+  }
+  _committed = _readSequence;
+  _backlog -= _readCount;
+  _readCount = 0;
+  _tail = _read;
+  return true;
+}
+
+/**
+ * Forgets the dots read since the last commit, they are read again
+ */
+
+void UbiSpool::rewind() {
+  _read = _tail;
+  _readSequence = _committed;
+  _readCount = 0;
+}
+
+/**
+ * Sends the next batch of dots to a device and commits it once it is
+ * acknowledged. The batch takes the free slots of the dots buffer of the
+ * instance. A failed batch, or the dots that did not fit in its payload, stay
+ * in that buffer and are sent again by the next call; the batch is committed
+ * once the buffer is empty. A pipelined send() returns before the server
+ * answered, so replay() is refused while the pipeline of the instance is open.
+ * @arg device_label [Mandatory] device label where the dots will be stored
+ * @return false if the batch could not be sent
+ */
+
+bool UbiSpool::replay(const char *device_label) {
+  if (_ubidots->pipelined()) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] The spool can not be replayed while the pipeline is open"));
+    }
+    return false;
+  }
+  if (!_retryPending) {
+    uint8_t room = MAX_VALUES - _ubidots->pendingDots();
+    if (room == 0) {
+      if (UBI_LOG_ERROR) {
+        Serial.println(F("[ERROR] The dots buffer of the instance is full, send() it before replaying"));
+      }
+      return false;
+    }
+    _batchCount = read(_batch, room);
+    if (_batchCount == 0) {
+      return true;
+    }
+    for (uint8_t i = 0; i < _batchCount; i++) {
+      addTo(_ubidots, _batch[i]);
+    }
+  }
+  bool sent = _ubidots->send(device_label);
+  _retryPending = _ubidots->pendingDots() > 0;
+  if (!sent) {
+    return false;
+  }
+  return _retryPending || commit();
+}
+
+/**************************************************************************
+ * Private Methods
+ ***************************************************************************/
+
+bool UbiSpool::_prepare(UbiSpoolRecord *record, const char *variable_label, uint8_t value_type,
+                        uint64_t dot_timestamp) {
+  if (_storage == NULL || strlen(variable_label) >= UBI_SPOOL_LABEL_SIZE) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] The spool is not opened or the variable label is too long"));
+    }
+    return false;
+  }
+  memset(record, 0, sizeof(UbiSpoolRecord));
+  record->kind = UBI_SPOOL_DOT;
+  record->value_type = value_type;
+  record->timestamp = dot_timestamp != 0 ? dot_timestamp : _ubidots->now();
+  strcpy(record->variable_label, variable_label);
+  return true;
+}
+
+bool UbiSpool::_addDot(UbiSpoolRecord *record) {
+  if (!_append(record)) {
+    return false;
+  }
+  _backlog++;
+  return true;
+}
+
+/**
+ * Writes a record at the end of the log, opening the next segment when the
+ * head is full
+ */
+
+bool UbiSpool::_append(UbiSpoolRecord *record) {
+  if (_head.slot >= _slots) {
+    uint8_t segment = (_head.segment + 1) % _storage->segments();
+    if (segment == _tail.segment && !_atHead(_tail)) {
+      _dropSegment(segment);
+    }
+    if (!_openSegment(segment)) {
+      return false;
+    }
+  }
+  record->sequence = _nextSequence++;
+  record->magic = UBI_SPOOL_MAGIC;
+  record->crc = UbiUtils::crc16(record, offsetof(UbiSpoolRecord, crc));
+  if (!_storage->write(_head.segment, (uint32_t)_head.slot * sizeof(UbiSpoolRecord), record,
+                       sizeof(UbiSpoolRecord))) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] Could not write to the spool"));
+    }
+    // The slot may hold a torn record now
+    _head.slot = _slots;
+    return false;
+  }
+  _head.slot++;
+  return true;
+}
+
+bool UbiSpool::_openSegment(uint8_t segment) {
+  UbiSpoolRecord record;
+  memset(&record, 0, sizeof(record));
+  record.kind = UBI_SPOOL_SEGMENT;
+  record.timestamp = _committed;
+  record.sequence = _nextSequence++;
+  record.magic = UBI_SPOOL_MAGIC;
+  record.crc = UbiUtils::crc16(&record, offsetof(UbiSpoolRecord, crc));
+  if (!_storage->erase(segment) || !_storage->write(segment, 0, &record, sizeof(record))) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] Could not open a spool segment"));
+    }
+    return false;
+  }
+  _head.segment = segment;
+  _head.slot = 1;
+  return true;
+}
+
+/**
+ * Drops the oldest segment, which holds dots that were not acknowledged yet
+ */
+
+void UbiSpool::_dropSegment(uint8_t segment) {
+  uint32_t dropped = 0;
+  UbiSpoolRecord record;
+  for (uint16_t slot = _tail.slot; slot < _slots; slot++) {
+    if (!_readRecord(segment, slot, &record) || record.kind != UBI_SPOOL_DOT || record.sequence <= _committed) {
+      continue;
+    }
+    _backlog--;
+    // Dots already read are still sent from memory
+    if (record.sequence <= _readSequence) {
+      _readCount--;
+    } else {
+      dropped++;
+    }
+  }
+  _dropped += dropped;
+
+  Cursor next = {(uint8_t)((segment + 1) % _storage->segments()), 1};
+  if (_read.segment == segment) {
+    _read = next;
+  }
+  _tail = next;
+  if (UBI_LOG_ERROR && dropped > 0) {
+    Serial.print(F("[ERROR] The spool is full, dropped "));
+    Serial.print(dropped);
+    Serial.println(F(" dots"));
+  }
+}
+
+/**
+ * Reads a record, an unreadable slot reads as blank
+ * @return true if the record is complete and its CRC matches
+ */
+
+bool UbiSpool::_readRecord(uint8_t segment, uint16_t slot, UbiSpoolRecord *record) {
+  memset(record, 0xFF, sizeof(UbiSpoolRecord));
+  if (slot >= _slots ||
+      !_storage->read(segment, (uint32_t)slot * sizeof(UbiSpoolRecord), record, sizeof(UbiSpoolRecord))) {
+    memset(record, 0xFF, sizeof(UbiSpoolRecord));
+    return false;
+  }
+  return valid(*record);
+}
+
+/**
+ * Adds a dot record to the dots buffer of an instance with the type of its
+ * value. The buffer references the label of the record, nothing is copied, so
+ * the record must stay unchanged until the dot is sent.
+ */
+
+void UbiSpool::addTo(Ubidots *ubidots, const UbiSpoolRecord &record) {
+  UbiTypedValue value;
+  value.value_type = record.value_type;
+  value.value_scale = record.value_scale;
+  memcpy(&value.dot_int, &record.dot_int, sizeof(value.dot_int));
+  ubidots->addValue(record.variable_label, value, NULL, record.timestamp);
+}
+
+/**
+ * Tells if a record is complete and its CRC matches, to read spool segments
+ * copied off the board
+ */
+
+bool UbiSpool::valid(const UbiSpoolRecord &record) {
+  return record.magic == UBI_SPOOL_MAGIC && record.kind >= UBI_SPOOL_DOT && record.kind <= UBI_SPOOL_SEGMENT &&
+         record.crc == UbiUtils::crc16(&record, offsetof(UbiSpoolRecord, crc));
+}
+
+/**
+ * Erased flash reads as 0xFF, other storages may read as zeros
+ */
+
+bool UbiSpool::_blank(const UbiSpoolRecord &record) const {
+  const uint8_t *bytes = (const uint8_t *)&record;
+  for (size_t i = 1; i < sizeof(UbiSpoolRecord); i++) {
+    if (bytes[i] != bytes[0]) {
+      return false;
+    }
+  }
+  return bytes[0] == 0xFF || bytes[0] == 0x00;
+}
+
+/**
+ * Moves to the next slot, the segments past the head are wrapped around
+ */
+
+void UbiSpool::_next(Cursor *cursor) const {
+  cursor->slot++;
+  if (cursor->slot >= _slots && cursor->segment != _head.segment) {
+    cursor->segment = (cursor->segment + 1) % _storage->segments();
+    cursor->slot = 1;
+  }
+}
@@ -0,0 +1,133 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiSpool_H_
+#define _UbiSpool_H_
+
+#include "Ubidots.h"
+
+typedef enum { UBI_SPOOL_DOT = 1, UBI_SPOOL_COMMIT, UBI_SPOOL_SEGMENT } UbiSpoolRecordKind;
+
+/**
+ * Fixed-size record of the spool. Dots keep their typed value, commit records
+ * keep the last acknowledged dot sequence in timestamp, and the first record
+ * of every segment keeps the committed sequence at the time it was opened.
+ */
+
+typedef struct UbiSpoolRecord {
+  uint32_t sequence;
+  uint8_t magic;
+  uint8_t kind;
+  uint8_t value_type;
+  uint8_t value_scale;
+  uint64_t timestamp;
+  union {
+    float dot_value;
+    int64_t dot_int;
+    double dot_double;
+  };
+  char variable_label[UBI_SPOOL_LABEL_SIZE];
+  uint16_t crc;
+} UbiSpoolRecord;
+
+/**
+ * Storage of the spool, implemented by the sketch over an SD card, a SPI
+ * flash or the internal flash. The storage is split in segments of the same
+ * size that are written in order and erased as a whole, so write() is only
+ * called with increasing offsets on an erased segment.
+ */
+
+class UbiSpoolStorage {
+public:
+  virtual uint8_t segments() = 0;
+  virtual uint32_t segmentSize() = 0;
+  virtual bool read(uint8_t segment, uint32_t offset, void *data, uint16_t length) = 0;
+  virtual bool write(uint8_t segment, uint32_t offset, const void *data, uint16_t length) = 0;
+  virtual bool erase(uint8_t segment) = 0;
+  virtual ~UbiSpoolStorage() {}
+};
+
+/**
+ * Persistent backlog of dots that survives reboots and long outages. Dots are
+ * appended to a log of fixed-size records with a CRC, and replay() sends them
+ * in order through an Ubidots instance. The commit cursor is itself appended
+ * to the log and only moves once the server acknowledged a batch, so after a
+ * reboot the unacknowledged dots are sent again. When the storage is full the
+ * oldest segment is dropped.
+ */
+
+class UbiSpool {
+public:
+  explicit UbiSpool(Ubidots *ubidots);
+  bool begin(UbiSpoolStorage *storage);
+  bool add(const char *variable_label, float value, uint64_t dot_timestamp = 0);
+  bool addInt(const char *variable_label, int64_t value, uint64_t dot_timestamp = 0);
+  bool addFixed(const char *variable_label, int64_t value, uint8_t decimals, uint64_t dot_timestamp = 0);
+  bool addDouble(const char *variable_label, double value, uint64_t dot_timestamp = 0);
+  uint8_t read(UbiSpoolRecord *records, uint8_t max_records);
+  bool commit();
+  void rewind();
+  bool replay(const char *device_label);
+  uint32_t backlog() const { return _backlog; }
+  uint32_t dropped() const { return _dropped; }
+  void setDebug(bool debug) { _debug = debug; }
+  static bool valid(const UbiSpoolRecord &record);
+  static void addTo(Ubidots *ubidots, const UbiSpoolRecord &record);
+
+private:
+  typedef struct Cursor {
+    uint8_t segment;
+    uint16_t slot;
+  } Cursor;
+
+  Ubidots *_ubidots;
+  UbiSpoolStorage *_storage = NULL;
+  bool _debug = UBI_DEBUG_DEFAULT;
+  uint16_t _slots = 0;
+  uint32_t _nextSequence = 1;
+  uint32_t _committed = 0;
+  uint32_t _readSequence = 0;
+  uint32_t _readCount = 0;
+  uint32_t _backlog = 0;
+  uint32_t _dropped = 0;
+  Cursor _head;
+  Cursor _tail;
+  Cursor _read;
+  // Records of the batch being replayed, the dots buffer references their labels
+  UbiSpoolRecord _batch[MAX_VALUES];
+  uint8_t _batchCount = 0;
+  bool _retryPending = false;
+
+  bool _prepare(UbiSpoolRecord *record, const char *variable_label, uint8_t value_type, uint64_t dot_timestamp);
+  bool _addDot(UbiSpoolRecord *record);
+  bool _append(UbiSpoolRecord *record);
+  bool _openSegment(uint8_t segment);
+  void _dropSegment(uint8_t segment);
+  bool _readRecord(uint8_t segment, uint16_t slot, UbiSpoolRecord *record);
+  bool _blank(const UbiSpoolRecord &record) const;
+  bool _atHead(const Cursor &cursor) const { return cursor.segment == _head.segment && cursor.slot >= _head.slot; }
+  void _next(Cursor *cursor) const;
+};
+
+#endif
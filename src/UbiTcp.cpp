@@ -28,15 +28,14 @@ Inc
  * Overloaded constructors
  ***************************************************************************/
 
-UbiTCP::UbiTCP(const char *host, const int port, const char *token) : UbiProtocol(host, token, port) {}
+UbiTCP::UbiTCP(const char *host, const int port, const char *token)
+    : UbiProtocol(host, token, port), _client(&_client_tcps_ubi), _writer(&_client_tcps_ubi) {}
 
 /**************************************************************************
  * Destructor
  ***************************************************************************/
 
 UbiTCP::~UbiTCP() {
-  delete[] _host;
-  delete[] _token;
 }
 
 /**************************************************************************
@@ -44,112 +43,335 @@ UbiTCP::~UbiTCP() {
  ***************************************************************************/
 
 bool UbiTCP::sendData(const char *device_label, const char *device_name, char *payload) {
-  if (_debug) {
-    Serial.print(F("Connecting to "));
-    Serial.print(_host);
-    Serial.print(F(" on Port: "));
-    Serial.println(_port);
+  if (_pipelined) {
+    return false;
   }
-
-  if (!_client_tcps_ubi.connectSSL(_host, _port)) {
-    if (_debug) {
-      Serial.println(F("Connection Failed to Ubidots - Try Again"));
-    }
-    if (!reconnect<WiFiSSLClient>(&_client_tcps_ubi)) {
-      return ERROR_VALUE;
-    }
+  if (!connectClient(&_client_tcps_ubi, &_client)) {
+    return false;
   }
+  _writer.setClient(_client);
 
-  if (_debug) {
+  if (UBI_LOG_DEBUG) {
     Serial.println(F("Payload"));
     Serial.println(payload);
   }
 
-  _client_tcps_ubi.print(payload);
+  _writer.resetStats();
+  _writer.print(payload);
+  _writer.flush();
+  _traceEvent(UBI_TRACE_REQUEST_WRITTEN, _writer.transactions(), _writer.bytes());
+  if (UBI_LOG_DEBUG) {
+    printWriterStats(_writer);
+  }
 
   /* Waits for the host's answer */
   if (!waitServerAnswer()) {
-    if (_debug) {
-      Serial.println("[ERROR] Could not read server's response");
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] Could not read server's response"));
     }
-    _client_tcps_ubi.flush();
-    _client_tcps_ubi.stop();
+    _writer.discard();
+    disconnectClient(_client, false);
     return false;
   }
 
-  float value = parseTCPAnswer("POST");
-  if (value != ERROR_VALUE) {
-    _client_tcps_ubi.flush();
-    _client_tcps_ubi.stop();
-    return true;
-  }
-  _client_tcps_ubi.flush();
-  _client_tcps_ubi.stop();
-  return false;
+  double value = parseTCPAnswer("POST");
+  _traceEvent(UBI_TRACE_TCP_RESPONSE, value != ERROR_VALUE);
+  disconnectClient(_client, true);
+  return value != ERROR_VALUE;
 }
 
-double UbiTCP::get(const char *device_label, const char *variable_label) {
-
-  /* Connecting the client */
-
-  if (_debug) {
-    Serial.print(F("Connecting to "));
-    Serial.print(_host);
-    Serial.print(F(" on Port: "));
-    Serial.println(_port);
-  }
+/**
+ * @arg text [Mandatory] buffer to store the value as the server wrote it
+ * @arg size [Mandatory] size of the buffer
+ */
 
-  if (!_client_tcps_ubi.connectSSL(_host, _port)) {
-    if (_debug) {
-      Serial.println(F("Connection Failed to Ubidots - Try Again"));
-    }
-    if (!reconnect<WiFiSSLClient>(&_client_tcps_ubi)) {
-      return ERROR_VALUE;
+bool UbiTCP::getText(const char *device_label, const char *variable_label, char *text, size_t size) {
+  // The pipeline owns the socket, reconnecting it would lose the frames in flight
+  if (_pipelined) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] Use getPipelined() while the pipeline is open"));
     }
+    return false;
   }
-
-  if (!_client_tcps_ubi.connected()) {
-    if (_debug) {
-      Serial.println(F("[ERROR] Could not connect to the server"));
-    }
-    return ERROR_VALUE;
+  if (!connectClient(&_client_tcps_ubi, &_client)) {
+    return false;
   }
+  _writer.setClient(_client);
 
   /* Builds the request POST - Please reference this link to know all the
    * request's structures https://ubidots.com/docs/api/ */
-  _client_tcps_ubi.print(USER_AGENT);
-  _client_tcps_ubi.print("|LV|");
-  _client_tcps_ubi.print(_token);
-  _client_tcps_ubi.print("|");
-  _client_tcps_ubi.print(device_label);
-  _client_tcps_ubi.print(":");
-  _client_tcps_ubi.print(variable_label);
-  _client_tcps_ubi.print("|end");
-
-  if (_debug) {
-    Serial.println("----");
-    Serial.println("Payload for request:");
+  _writer.resetStats();
+  _writer.print(USER_AGENT);
+  _writer.print("|LV|");
+  _writer.print(_token);
+  _writer.print("|");
+  _writer.print(device_label);
+  _writer.print(":");
+  _writer.print(variable_label);
+  _writer.print("|end");
+  _writer.flush();
+  _traceEvent(UBI_TRACE_REQUEST_WRITTEN, _writer.transactions(), _writer.bytes());
+
+  if (UBI_LOG_DEBUG) {
+    Serial.println(F("----"));
+    Serial.println(F("Payload for request:"));
     Serial.print(USER_AGENT);
-    Serial.print("|LV|");
+    Serial.print(F("|LV|"));
     Serial.print(_token);
-    Serial.print("|");
+    Serial.print(F("|"));
     Serial.print(device_label);
-    Serial.print(":");
+    Serial.print(F(":"));
     Serial.print(variable_label);
-    Serial.print("|end");
-    Serial.println("\n----");
+    Serial.print(F("|end"));
+    Serial.println(F("\n----"));
+    printWriterStats(_writer);
   }
 
   /* Waits for the host's answer */
   if (!waitServerAnswer()) {
-    return ERROR_VALUE;
+    _writer.discard();
+    disconnectClient(_client, false);
+    return false;
+  }
+
+  double value = parseTCPAnswer("LV", text, size);
+  _traceEvent(UBI_TRACE_TCP_RESPONSE, value != ERROR_VALUE);
+  disconnectClient(_client, true);
+  return value != ERROR_VALUE;
+}
+
+/**************************************************************************
+ * Pipelined requests
+ ***************************************************************************/
+
+/**
+ * Opens a socket that is kept alive for several requests. Frames queued with
+ * pipelinePost() and pipelineGet() are written back-to-back, up to
+ * UBI_PIPELINE_DEPTH of them are in flight at once, and the answers are
+ * matched in order as they arrive.
+ * @arg callback [Mandatory] called once per frame with the sequence number
+ * assigned in queueing order starting at zero, whether the server answered
+ * OK, and the retrieved value for pipelineGet() frames
+ * @return false if the server could not be reached
+ */
+
+bool UbiTCP::beginPipeline(UbiPipelineCallback callback) {
+  _pipelineCallback = callback;
+  _inFlightHead = 0;
+  _inFlightCount = 0;
+  _nextSequence = 0;
+  _pipelineResponseLength = 0;
+  _pipelined = true;
+  return _pipelineConnect();
+}
+
+/**
+ * Tells the owner of the pipeline about every answer, in order
+ */
+
+void UbiTCP::setPipelineListener(UbiPipelineListener listener, void *context) {
+  _pipelineListener = listener;
+  _pipelineListenerContext = context;
+}
+
+bool UbiTCP::pipelinePost(const char *payload) {
+  if (!_pipelined || !_waitPipelineSlot()) {
+    return false;
+  }
+  if (UBI_LOG_DEBUG) {
+    Serial.print(F("Pipelined frame: "));
+    Serial.println(payload);
+  }
+  _writer.print(payload);
+  _pushFrame(false);
+  return true;
+}
+
+bool UbiTCP::pipelineGet(const char *device_label, const char *variable_label) {
+  if (!_pipelined || !_waitPipelineSlot()) {
+    return false;
   }
+  _writer.print(USER_AGENT);
+  _writer.print("|LV|");
+  _writer.print(_token);
+  _writer.print("|");
+  _writer.print(device_label);
+  _writer.print(":");
+  _writer.print(variable_label);
+  _writer.print("|end");
+  _pushFrame(true);
+  return true;
+}
+
+/**
+ * Writes out the queued frames and matches the answers already received
+ * @return number of frames completed by this call
+ */
+
+uint8_t UbiTCP::pollPipeline() {
+  if (!_pipelined) {
+    return 0;
+  }
+  _writer.flush();
+  _traceEvent(UBI_TRACE_REQUEST_WRITTEN, _writer.transactions(), _writer.bytes());
+
+  uint8_t completed = 0;
+  while (_client_tcps_ubi.available()) {
+    char c = _client_tcps_ubi.read();
+    _lastResponseByte = millis();
+    if (_pipelineResponseLength < UBI_PIPELINE_RESPONSE_SIZE - 1) {
+      _pipelineResponse[_pipelineResponseLength++] = c;
+    }
+
+    // Answers are not delimited, a new one starts with the next OK or ERROR
+    uint8_t markerLength = 0;
+    if (c == 'K' && _pipelineResponseLength > 2 && _pipelineResponse[_pipelineResponseLength - 2] == 'O') {
+      markerLength = 2;
+    } else if (c == 'R' && _pipelineResponseLength > 5 &&
+               strncmp(_pipelineResponse + _pipelineResponseLength - 5, "ERROR", 5) == 0) {
+      markerLength = 5;
+    }
+    if (markerLength > 0 && _inFlightCount > 0) {
+      _completeFrame(_pipelineResponse, _pipelineResponseLength - markerLength);
+      memmove(_pipelineResponse, _pipelineResponse + _pipelineResponseLength - markerLength, markerLength);
+      _pipelineResponseLength = markerLength;
+      completed++;
+    }
+  }
+
+  // The last answer is complete once the server stays quiet for a while
+  if (_pipelineResponseLength > 0 && _inFlightCount > 0 && millis() - _lastResponseByte > UBI_PIPELINE_QUIET_TIME) {
+    _completeFrame(_pipelineResponse, _pipelineResponseLength);
+    _pipelineResponseLength = 0;
+    completed++;
+  }
+
+  if (_inFlightCount > 0 && !_client_tcps_ubi.connected() && !_client_tcps_ubi.available()) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("[ERROR] Connection closed with frames in flight"));
+    }
+    _failInFlightFrames();
+  }
+  return completed;
+}
 
-  float value = parseTCPAnswer("LV");
+/**
+ * Waits for every frame in flight to be answered and closes the socket
+ * @return true if all the frames were answered
+ */
+
+bool UbiTCP::endPipeline() {
+  if (!_pipelined) {
+    return false;
+  }
+  unsigned long lastProgress = millis();
+  while (_inFlightCount > 0 && millis() - lastProgress < (unsigned long)_timeout) {
+    if (pollPipeline() > 0) {
+      lastProgress = millis();
+    }
+    delay(1);
+  }
+
+  bool result = _inFlightCount == 0;
+  if (!result) {
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("timeout, could not read every pipelined response"));
+    }
+    _failInFlightFrames();
+  }
+  _pipelined = false;
   _client_tcps_ubi.flush();
   _client_tcps_ubi.stop();
-  return value;
-  // return 0;
+  return result;
+}
+
+bool UbiTCP::_pipelineConnect() {
+  // The pipeline keeps its own socket, out of the connection pool
+  _writer.setClient(&_client_tcps_ubi);
+  if (_client_tcps_ubi.connected()) {
+    return true;
+  }
+  if (UBI_LOG_INFO) {
+    Serial.print(F("Connecting to "));
+    Serial.print(_host);
+    Serial.print(F(" on Port: "));
+    Serial.println(_port);
+  }
+  if (!_client_tcps_ubi.connectSSL(_host, _port) && !reconnect<WiFiSSLClient>(&_client_tcps_ubi)) {
+    return false;
+  }
+  _writer.resetStats();
+  return true;
+}
+
+/**
+ * Drains answers until there is room for one more frame in flight
+ */
+
+bool UbiTCP::_waitPipelineSlot() {
+  unsigned long lastProgress = millis();
+  while (_inFlightCount >= UBI_PIPELINE_DEPTH) {
+    if (pollPipeline() > 0) {
+      lastProgress = millis();
+    } else if (millis() - lastProgress >= (unsigned long)_timeout) {
+      if (UBI_LOG_ERROR) {
+        Serial.println(F("timeout, pipeline is full"));
+      }
+      _failInFlightFrames();
+      _writer.discard();
+      _client_tcps_ubi.stop();
+    }
+    delay(1);
+  }
+  return _pipelineConnect();
+}
+
+void UbiTCP::_pushFrame(bool lastValue) {
+  InFlightFrame *frame = &_inFlight[(_inFlightHead + _inFlightCount) % UBI_PIPELINE_DEPTH];
+  frame->sequence = _nextSequence++;
+  frame->lastValue = lastValue;
+  if (_inFlightCount == 0) {
+    _lastResponseByte = millis();
+  }
+  _inFlightCount++;
+}
+
+void UbiTCP::_completeFrame(const char *response, uint8_t length) {
+  InFlightFrame *frame = &_inFlight[_inFlightHead];
+  _inFlightHead = (_inFlightHead + 1) % UBI_PIPELINE_DEPTH;
+  _inFlightCount--;
+
+  char answer[UBI_PIPELINE_RESPONSE_SIZE];
+  memcpy(answer, response, length);
+  answer[length] = '\0';
+
+  bool success = strncmp(answer, "OK", 2) == 0;
+  double value = success ? 0 : ERROR_VALUE;
+  if (success && frame->lastValue) {
+    char *pch = strchr(answer, '|');
+    value = pch != NULL ? atof(pch + 1) : ERROR_VALUE;
+    success = pch != NULL;
+  }
+
+  if (UBI_LOG_DEBUG) {
+    Serial.print(F("Pipelined response "));
+    Serial.print(frame->sequence);
+    Serial.print(F(": "));
+    Serial.println(answer);
+  }
+  if (_pipelineListener != NULL) {
+    _pipelineListener(_pipelineListenerContext, success);
+  }
+  if (_pipelineCallback != NULL) {
+    _pipelineCallback(frame->sequence, success, value);
+  }
+}
+
+void UbiTCP::_failInFlightFrames() {
+  while (_inFlightCount > 0) {
+    _completeFrame("ERROR", 5);
+  }
+  _pipelineResponseLength = 0;
 }
 
 /**************************************************************************
@@ -164,15 +386,14 @@ double UbiTCP::get(const char *device_label, const char *variable_label) {
 
 bool UbiTCP::waitServerAnswer() {
   int timeout = 0;
-  while (!_client_tcps_ubi.available() && timeout < _timeout) {
+  while (!_client->available() && timeout < _timeout) {
     timeout++;
     delay(1);
     if (timeout > _timeout - 1) {
-      if (_debug) {
-        Serial.println("timeout, could not read any response from the host");
+      _traceEvent(UBI_TRACE_TIMEOUT);
+      if (UBI_LOG_ERROR) {
+        Serial.println(F("timeout, could not read any response from the host"));
       }
-      _client_tcps_ubi.flush();
-      _client_tcps_ubi.stop();
       return false;
     }
   }
@@ -181,26 +402,47 @@ bool UbiTCP::waitServerAnswer() {
 
 /**
  * Parse the TCP host answer and saves it to the input char pointer.
- * @payload [Mandatory] char payload pointer to store the host answer.
+ * @text [Optional] buffer to store the text of a last value
+ * @size [Optional] size of the buffer
  * @return true if there is an 'Ok' in the answer, false if not.
  */
 
-float UbiTCP::parseTCPAnswer(const char *request_type) {
+double UbiTCP::parseTCPAnswer(const char *request_type, char *text, size_t size) {
 
-  if (_debug) {
-    Serial.println("----------");
-    Serial.println("Server's response:");
+  if (UBI_LOG_DEBUG) {
+    Serial.println(F("----------"));
+    Serial.println(F("Server's response:"));
+  }
+  // The connection may be kept opened, so a POST answer ends once it is parsed
+  // instead of when the server closes it. A last value has no terminator, it
+  // ends with the quiet time or when the server closes the socket.
+  bool lastValue = strcmp(request_type, "LV") == 0;
+  char readFromServer[UBI_PIPELINE_RESPONSE_SIZE];
+  uint8_t length = 0;
+  readFromServer[0] = '\0';
+  unsigned long lastByte = millis();
+  while (millis() - lastByte < UBI_PIPELINE_QUIET_TIME) {
+    if (!_client->available()) {
+      if (_answerComplete(readFromServer, length, lastValue) || !_client->connected()) {
+        break;
+      }
+      delay(1);
+      continue;
+    }
+    int c = _client->read();
+    if (length < UBI_PIPELINE_RESPONSE_SIZE - 1) {
+      readFromServer[length++] = (char)c;
+      readFromServer[length] = '\0';
+    }
+    lastByte = millis();
   }
-  char *readFromServer = (char *)malloc(sizeof(char) * 100);
-
-  readFromServer = strdup(_client_tcps_ubi.readString().c_str());
 
-  if (_debug) {
+  if (UBI_LOG_DEBUG) {
     Serial.println(readFromServer);
-    Serial.println("----------");
+    Serial.println(F("----------"));
   }
 
-  float result = ERROR_VALUE;
+  double result = ERROR_VALUE;
 
   // POST
   if (strcmp(request_type, "POST") == 0) {
@@ -213,17 +455,47 @@ float UbiTCP::parseTCPAnswer(const char *request_type) {
 
   // LV
   char *pch = strchr(readFromServer, '|');
-  if (pch != NULL) {
-    result = atof(pch + 1);
+  if (pch != NULL && strncmp(readFromServer, "OK", 2) == 0) {
+    result = strtod(pch + 1, NULL);
+    if (text != NULL) {
+      if (strlen(pch + 1) >= size) {
+        return ERROR_VALUE;
+      }
+      strcpy(text, pch + 1);
+    }
   }
 
-  free(readFromServer);
-
   return result;
 }
 
+/**
+ * A POST answer is complete once it is "OK" or starts with "ERROR". A last
+ * value never is, "OK|2" may be followed by "3.5" in the next read.
+ */
+
+bool UbiTCP::_answerComplete(const char *answer, uint8_t length, bool lastValue) {
+  if (lastValue) {
+    return false;
+  }
+  return (length >= 5 && strncmp(answer, "ERROR", 5) == 0) || (length >= 2 && strncmp(answer, "OK", 2) == 0);
+}
+
 /*
  * Checks if the socket is still opened with the Ubidots Server
  */
 
 bool UbiTCP::serverConnected() { return _client_tcps_ubi.connected(); }
+
+/*
+ * Checks if the server can be reached opening a connection, with a single
+ * attempt
+ */
+
+bool UbiTCP::probe() {
+  if (_client_tcps_ubi.connected()) {
+    return true;
+  }
+  bool connected = _client_tcps_ubi.connectSSL(_host, _port);
+  _client_tcps_ubi.stop();
+  return connected;
+}
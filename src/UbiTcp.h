@@ -32,15 +32,49 @@ class UbiTCP : public UbiProtocol {
 public:
   UbiTCP(const char *host, const int port, const char *token);
   bool sendData(const char *device_label, const char *device_name, char *payload);
-  double get(const char *device_label, const char *variable_label);
+  bool getText(const char *device_label, const char *variable_label, char *text, size_t size);
   bool serverConnected();
+  bool probe();
+  bool beginPipeline(UbiPipelineCallback callback);
+  bool pipelinePost(const char *payload);
+  bool pipelineGet(const char *device_label, const char *variable_label);
+  uint8_t pollPipeline();
+  uint8_t pipelineSlots() const { return _pipelined ? UBI_PIPELINE_DEPTH - _inFlightCount : 0; }
+  bool endPipeline();
+  bool pipelined() const { return _pipelined; }
+  void setPipelineListener(UbiPipelineListener listener, void *context);
   ~UbiTCP();
 
 private:
+  typedef struct InFlightFrame {
+    uint16_t sequence;
+    bool lastValue;
+  } InFlightFrame;
+
   WiFiSSLClient _client_tcps_ubi;
+  WiFiSSLClient *_client;
+  UbiBufferedClient _writer;
+
+  bool _pipelined = false;
+  UbiPipelineCallback _pipelineCallback = NULL;
+  UbiPipelineListener _pipelineListener = NULL;
+  void *_pipelineListenerContext = NULL;
+  InFlightFrame _inFlight[UBI_PIPELINE_DEPTH];
+  uint8_t _inFlightHead = 0;
+  uint8_t _inFlightCount = 0;
+  uint16_t _nextSequence = 0;
+  char _pipelineResponse[UBI_PIPELINE_RESPONSE_SIZE];
+  uint8_t _pipelineResponseLength = 0;
+  unsigned long _lastResponseByte = 0;
 
   bool waitServerAnswer();
-  float parseTCPAnswer(const char *request_type);
+  double parseTCPAnswer(const char *request_type, char *text = NULL, size_t size = 0);
+  static bool _answerComplete(const char *answer, uint8_t length, bool lastValue);
+  bool _pipelineConnect();
+  bool _waitPipelineSlot();
+  void _pushFrame(bool lastValue);
+  void _completeFrame(const char *response, uint8_t length);
+  void _failInFlightFrames();
 };
 
 #endif
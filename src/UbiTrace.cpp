@@ -0,0 +1,126 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiTrace.h"
+
+namespace {
+
+void writeLittleEndian(Print *output, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++) {
+    output->write((uint8_t)(value >> (8 * i)));
+  }
+}
+
+}  // namespace
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiTrace::UbiTrace() : _events(NULL), _output(NULL), _head(0), _tail(0), _dropped(0), _reportedDrops(0) {}
+
+UbiTrace::~UbiTrace() { end(); }
+
+/**************************************************************************
+ * Recording
+ ***************************************************************************/
+
+/**
+ * Starts tracing
+ * @arg output [Mandatory] where drain() writes the frames, e.g. &Serial
+ * @return false if the ring buffer could not be allocated
+ */
+
+bool UbiTrace::begin(Print *output) {
+  if (_events == NULL) {
+    _events = (UbiTraceEvent *)malloc(UBI_TRACE_SIZE * sizeof(UbiTraceEvent));
+  }
+  _output = output;
+  _head = 0;
+  _tail = 0;
+  _dropped = 0;
+  _reportedDrops = 0;
+  return _events != NULL;
+}
+
+void UbiTrace::end() {
+  free(_events);
+  _events = NULL;
+  _output = NULL;
+}
+
+void UbiTrace::record(UbiTraceEventId id, uint16_t arg0, uint32_t arg1) {
+  if (_events == NULL) {
+    return;
+  }
+  uint8_t head = _head;
+  uint8_t next = (head + 1) % UBI_TRACE_SIZE;
+  if (next == _tail) {
+    _dropped++;
+    return;
+  }
+  UbiTraceEvent *event = _events + head;
+  event->time = micros();
+  event->id = id;
+  event->arg0 = arg0;
+  event->arg1 = arg1;
+  // The slot is filled before it is published to drain()
+  _head = next;
+}
+
+/**
+ * Writes the pending events to the output
+ * @arg max_events [Optional] maximum events written per call, keeps loop()
+ * short
+ * @return number of events written
+ */
+
+uint8_t UbiTrace::drain(uint8_t max_events) {
+  if (_events == NULL || _output == NULL) {
+    return 0;
+  }
+  uint8_t written = 0;
+  if (_dropped != _reportedDrops) {
+    uint32_t dropped = _dropped;
+    UbiTraceEvent event = {micros(), UBI_TRACE_DROPPED, 0, dropped - _reportedDrops};
+    _write(event);
+    _reportedDrops = dropped;
+    written++;
+  }
+  while (_tail != _head && written < max_events) {
+    _write(_events[_tail]);
+    _tail = (_tail + 1) % UBI_TRACE_SIZE;
+    written++;
+  }
+  return written;
+}
+
+void UbiTrace::_write(const UbiTraceEvent &event) {
+  _output->write((uint8_t)0xA5);
+  _output->write((uint8_t)0x5A);
+  _output->write(event.id);
+  writeLittleEndian(_output, event.arg0, 2);
+  writeLittleEndian(_output, event.time, 4);
+  writeLittleEndian(_output, event.arg1, 4);
+}
@@ -0,0 +1,97 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiTrace_H_
+#define _UbiTrace_H_
+
+#include <Arduino.h>
+
+#include "UbiConstants.h"
+
+/**
+ * Event ids, extras/trace_decoder/ubitrace.py must be updated when they change
+ */
+
+typedef enum {
+  UBI_TRACE_DROPPED = 0,
+  UBI_TRACE_SEND_BEGIN = 1,
+  UBI_TRACE_PAYLOAD_BUILT = 2,
+  UBI_TRACE_SEND_END = 3,
+  UBI_TRACE_RETRY = 4,
+  UBI_TRACE_REQUEUE = 5,
+  UBI_TRACE_GET_BEGIN = 6,
+  UBI_TRACE_GET_END = 7,
+  UBI_TRACE_CACHE_HIT = 8,
+  UBI_TRACE_CONNECT_BEGIN = 9,
+  UBI_TRACE_CONNECT_END = 10,
+  UBI_TRACE_REQUEST_WRITTEN = 11,
+  // HTTP status code of the answer
+  UBI_TRACE_RESPONSE = 12,
+  UBI_TRACE_TIMEOUT = 13,
+  UBI_TRACE_THROTTLED = 14,
+  // TCP answers carry no status code, only whether they were "OK"
+  UBI_TRACE_TCP_RESPONSE = 15
+} UbiTraceEventId;
+
+typedef struct UbiTraceEvent {
+  uint32_t time;
+  uint8_t id;
+  uint16_t arg0;
+  uint32_t arg1;
+} UbiTraceEvent;
+
+/**
+ * Binary trace sink. Events are stored in a ring buffer by the library and
+ * written to the output by drain(), called from loop(), so tracing does not
+ * change the timing of the requests. There is one producer and one consumer,
+ * each one only moves its own index. Events that find the ring full are
+ * counted and reported by the next drain().
+ *
+ * Frame: 0xA5 0x5A, id (1 byte), arg0 (2 bytes), time in us (4 bytes), arg1
+ * (4 bytes), little endian.
+ */
+
+class UbiTrace {
+public:
+  UbiTrace();
+  ~UbiTrace();
+  bool begin(Print *output);
+  void end();
+  bool enabled() const { return _events != NULL; }
+  void record(UbiTraceEventId id, uint16_t arg0 = 0, uint32_t arg1 = 0);
+  uint8_t drain(uint8_t max_events = UBI_TRACE_DRAIN_EVENTS);
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  UbiTraceEvent *_events;
+  Print *_output;
+  volatile uint8_t _head;
+  volatile uint8_t _tail;
+  volatile uint32_t _dropped;
+  uint32_t _reportedDrops;
+
+  void _write(const UbiTraceEvent &event);
+};
+
+#endif
@@ -26,14 +26,39 @@ Inc
 #ifndef _UbiTypes_H_
 #define _UbiTypes_H_
 
+#include <stdint.h>
+
+class UbiContext;
+
 typedef struct Value {
   const char *variable_label;
   char *dot_context;
-  float dot_value;
-  unsigned long dot_timestamp_seconds;
-  unsigned int dot_timestamp_millis;
+  const UbiContext *dot_context_ref;
+  union {
+    float dot_value;
+    int64_t dot_int;
+    double dot_double;
+  };
+  uint8_t value_type;
+  // Decimals of a fixed-point value, dot_int holds the value times 10^value_scale
+  uint8_t value_scale;
+  uint64_t dot_timestamp;
+  uint8_t priority;
+  unsigned long added_at;
 } Value;
 
+// Value of a dot with its type, kept by the queues that add the dot later
+typedef struct UbiTypedValue {
+  uint8_t value_type;
+  // Decimals of a fixed-point value, dot_int holds the value times 10^value_scale
+  uint8_t value_scale;
+  union {
+    float dot_value;
+    int64_t dot_int;
+    double dot_double;
+  };
+} UbiTypedValue;
+
 typedef struct ContextUbi {
   char *key_label;
   char *key_value;
@@ -41,6 +66,19 @@ typedef struct ContextUbi {
 
 typedef const char *UbiServer;
 
-typedef enum { UBI_HTTP, UBI_TCP, UBI_UDP } IotProtocol;
+typedef void (*UbiPipelineCallback)(uint16_t sequence, bool success, double value);
+
+// Internal hook of the pipeline, told about every answer before the callback
+typedef void (*UbiPipelineListener)(void *context, bool success);
+
+typedef void (*UbiSubscribeCallback)(const char *device_label, const char *variable_label, double value);
+
+typedef enum { UBI_HTTP, UBI_TCP, UBI_UDP, UBI_MQTT } IotProtocol;
+
+typedef enum { UBI_PRIORITY_NORMAL, UBI_PRIORITY_LOW, UBI_PRIORITY_HIGH } UbiPriority;
+
+typedef enum { UBI_VALUE_FLOAT, UBI_VALUE_INT, UBI_VALUE_FIXED, UBI_VALUE_DOUBLE } UbiValueType;
+
+typedef enum { UBI_BACKFILL_CSV, UBI_BACKFILL_BINARY } UbiBackfillFormat;
 
 #endif
@@ -35,8 +35,6 @@ UbiUDP::UbiUDP(const char *host, const int port, const char *token) : UbiProtoco
  ***************************************************************************/
 
 UbiUDP::~UbiUDP() {
-  delete[] _host;
-  delete[] _token;
   _client_udp_ubi.flush();
   _client_udp_ubi.stop();
 }
@@ -45,8 +43,8 @@ bool UbiUDP::sendData(const char *device_label, const char *device_name, char *p
   /* Sends data to Ubidots */
   _client_udp_ubi.begin(_port);
   if (!(_client_udp_ubi.beginPacket(_host, _port) && _client_udp_ubi.write(payload) && _client_udp_ubi.endPacket())) {
-    if (_debug) {
-      Serial.println("ERROR sending values with UDP");
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("ERROR sending values with UDP"));
     }
     _client_udp_ubi.stop();
     return false;
@@ -57,13 +55,22 @@ bool UbiUDP::sendData(const char *device_label, const char *device_name, char *p
   return true;
 }
 
-double UbiUDP::get(const char *device_label, const char *variable_label) { return ERROR_VALUE; }
+bool UbiUDP::getText(const char *device_label, const char *variable_label, char *text, size_t size) { return false; }
 
 /*
  * Checks if the socket is still opened with the Ubidots Server
  */
 
 bool UbiUDP::serverConnected() {
-  Serial.println("This method is not supported using UDP");
+  if (UBI_LOG_ERROR) {
+    Serial.println(F("This method is not supported using UDP"));
+  }
   return false;
 }
+
+/*
+ * UDP has no answer, the server can not be probed, so the probe never
+ * reports UDP as down
+ */
+
+bool UbiUDP::probe() { return true; }
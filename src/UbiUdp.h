@@ -34,8 +34,9 @@ class UbiUDP : public UbiProtocol {
 public:
   UbiUDP(const char *host, const int port, const char *token);
   bool sendData(const char *device_label, const char *device_name, char *payload);
-  double get(const char *device_label, const char *variable_label);
+  bool getText(const char *device_label, const char *variable_label, char *text, size_t size);
   bool serverConnected();
+  bool probe();
   ~UbiUDP();
 
 private:
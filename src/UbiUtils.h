@@ -2,6 +2,9 @@
 #ifndef _UbiUtils_
 #define _UbiUtils_
 
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 class UbiUtils {
@@ -49,6 +52,159 @@ public:
     return count;
   }
 
+  /*
+   * Writes the decimal digits of an unsigned value without null terminator
+   * @str_value [Mandatory] char pointer to store the digits.
+   * @value [Mandatory] value to convert
+   * @return number of digits written
+   */
+
+  static uint8_t unsignedToChar(char *str_value, uint64_t value) {
+    // Only the digits above 10^9 need the slow 64 bits division
+    if (value > 0xFFFFFFFFUL) {
+      uint8_t length = unsignedToChar(str_value, value / 1000000000UL);
+      uint32_t low = value % 1000000000UL;
+      for (int8_t i = 8; i >= 0; i--) {
+        str_value[length + i] = '0' + low % 10;
+        low /= 10;
+      }
+      return length + 9;
+    }
+
+    uint32_t low = value;
+    char reversed[10];
+    uint8_t length = 0;
+    do {
+      reversed[length++] = '0' + low % 10;
+      low /= 10;
+    } while (low != 0);
+    for (uint8_t i = 0; i < length; i++) {
+      str_value[i] = reversed[length - 1 - i];
+    }
+    return length;
+  }
+
+  /*
+   * Writes a signed integer without null terminator
+   * @return number of characters written
+   */
+
+  static uint8_t signedToChar(char *str_value, int64_t value) {
+    if (value >= 0) {
+      return unsignedToChar(str_value, value);
+    }
+    *str_value = '-';
+    // Negated as unsigned, so INT64_MIN does not overflow
+    return unsignedToChar(str_value + 1, 0 - (uint64_t)value) + 1;
+  }
+
+  /*
+   * Writes a fixed-point value without null terminator, e.g. 12345 with 2
+   * decimals is written as 123.45
+   * @arg decimals [Mandatory] number of decimal digits of the value
+   * @return number of characters written
+   */
+
+  static uint8_t fixedToChar(char *str_value, int64_t value, uint8_t decimals) {
+    if (decimals == 0) {
+      return signedToChar(str_value, value);
+    }
+    uint8_t length = 0;
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : value;
+    if (value < 0) {
+      str_value[length++] = '-';
+    }
+    uint64_t divisor = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+      divisor *= 10;
+    }
+    length += unsignedToChar(str_value + length, magnitude / divisor);
+    str_value[length++] = '.';
+    uint64_t fraction = magnitude % divisor;
+    for (int8_t i = decimals - 1; i >= 0; i--) {
+      str_value[length + i] = '0' + fraction % 10;
+      fraction /= 10;
+    }
+    return length + decimals;
+  }
+
+  /*
+   * Reads a decimal number as a fixed-point value from its digits, without
+   * going through a double, e.g. "123.456" with 2 decimals is read as 12346.
+   * Digits past the 18 significant ones are ignored.
+   * @arg decimals [Mandatory] number of decimal digits of the value
+   * @return false if the text is not a number or does not fit
+   */
+
+  static bool charToFixed(const char *str_value, uint8_t decimals, int64_t *value) {
+    const char *c = str_value;
+    bool negative = *c == '-';
+    if (*c == '-' || *c == '+') {
+      c++;
+    }
+    // The number is mantissa * 10^exponent
+    uint64_t mantissa = 0;
+    int16_t exponent = 0;
+    bool digits = false;
+    bool point = false;
+    for (; (*c >= '0' && *c <= '9') || (*c == '.' && !point); c++) {
+      if (*c == '.') {
+        point = true;
+        continue;
+      }
+      digits = true;
+      if (mantissa < 100000000000000000ULL) {
+        mantissa = mantissa * 10 + (*c - '0');
+        exponent -= point ? 1 : 0;
+      } else if (!point) {
+        exponent++;
+      }
+    }
+    if (!digits) {
+      return false;
+    }
+    if (*c == 'e' || *c == 'E') {
+      char *end;
+      long power = strtol(c + 1, &end, 10);
+      if (end == c + 1 || power < -400 || power > 400) {
+        return false;
+      }
+      exponent += power;
+      c = end;
+    }
+    if (*c != '\0') {
+      return false;
+    }
+
+    int16_t shift = exponent + decimals;
+    for (; shift > 0; shift--) {
+      if (mantissa > UINT64_MAX / 10) {
+        return false;
+      }
+      mantissa *= 10;
+    }
+    if (shift < 0) {
+      // Rounded half away from zero on the first dropped digit
+      for (; shift < -1 && mantissa > 0; shift++) {
+        mantissa /= 10;
+      }
+      uint8_t dropped = mantissa % 10;
+      mantissa = mantissa / 10 + (dropped >= 5 ? 1 : 0);
+    }
+    if (mantissa > (negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX)) {
+      return false;
+    }
+    *value = negative ? (int64_t)(0 - mantissa) : (int64_t)mantissa;
+    return true;
+  }
+
+  /*
+   * Writes a double with the 17 significant digits that make it read back
+   * exactly, with null terminator
+   */
+
+  static uint8_t doubleToChar(char *str_value, double value) { return sprintf(str_value, "%.17g", value); }
+
   /*
    * Stores the float type value into the char array input
    * @str_value [Mandatory] char payload pointer to store the value.
@@ -72,6 +228,42 @@ public:
       j++;
     }
   }
+
+  /*
+   * FNV-1a hash, used to match JSON keys while they are read
+   * @hash [Mandatory] hash of the previous characters, FNV_OFFSET_BASIS for the first one
+   * @c [Mandatory] next character
+   */
+
+  static const uint32_t FNV_OFFSET_BASIS = 2166136261UL;
+
+  static uint32_t fnv1a(uint32_t hash, char c) { return (hash ^ (uint8_t)c) * 16777619UL; }
+
+  static uint32_t fnv1a(const char *text) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    while (*text != '\0') {
+      hash = fnv1a(hash, *text++);
+    }
+    return hash;
+  }
+
+  /*
+   * CRC-16/CCITT-FALSE of a block, used to check the spool records
+   * @data [Mandatory] bytes to check
+   * @length [Mandatory] number of bytes
+   */
+
+  static uint16_t crc16(const void *data, size_t length) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint16_t crc = 0xFFFF;
+    while (length-- > 0) {
+      crc ^= (uint16_t)(*bytes++) << 8;
+      for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+    }
+    return crc;
+  }
 };
 
 #endif
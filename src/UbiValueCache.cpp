@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiValueCache.h"
+
+#include <Arduino.h>
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiValueCache::UbiValueCache() : _ttl(0), _staleTime(0), _hits(0), _staleHits(0), _misses(0) {
+  for (uint8_t i = 0; i < UBI_CACHE_SIZE; i++) {
+    _entries[i].valid = false;
+  }
+}
+
+/**
+ * @arg ttl [Mandatory] time in ms a value is served without asking the
+ * server, 0 disables the cache
+ * @arg staleTime [Mandatory] time in ms after the TTL during which the old
+ * value is still served while it is revalidated
+ */
+
+void UbiValueCache::setTtl(unsigned long ttl, unsigned long staleTime) {
+  _ttl = ttl;
+  _staleTime = staleTime;
+}
+
+UbiCacheStatus UbiValueCache::lookup(const char *device_label, const char *variable_label, double *value) {
+  CacheEntry *entry = _find(device_label, variable_label);
+  if (entry != NULL) {
+    unsigned long age = millis() - entry->storedAt;
+    if (age < entry->ttl) {
+      *value = entry->value;
+      _hits++;
+      return UBI_CACHE_FRESH;
+    }
+    if (age - entry->ttl < entry->staleTime) {
+      *value = entry->value;
+      entry->revalidate = true;
+      _staleHits++;
+      return UBI_CACHE_STALE;
+    }
+    entry->valid = false;
+  }
+  _misses++;
+  return UBI_CACHE_MISS;
+}
+
+void UbiValueCache::store(const char *device_label, const char *variable_label, double value) {
+  if (!enabled() || strlen(device_label) >= UBI_CACHE_LABEL_SIZE ||
+      strlen(variable_label) >= UBI_CACHE_LABEL_SIZE) {
+    return;
+  }
+
+  CacheEntry *entry = _find(device_label, variable_label);
+  if (entry == NULL) {
+    // Takes a free slot or evicts the oldest value
+    entry = &_entries[0];
+    for (uint8_t i = 0; i < UBI_CACHE_SIZE; i++) {
+      if (!_entries[i].valid) {
+        entry = &_entries[i];
+        break;
+      }
+      if (millis() - _entries[i].storedAt > millis() - entry->storedAt) {
+        entry = &_entries[i];
+      }
+    }
+    strcpy(entry->device_label, device_label);
+    strcpy(entry->variable_label, variable_label);
+  }
+
+  entry->valid = true;
+  entry->revalidate = false;
+  entry->value = value;
+  entry->storedAt = millis();
+  entry->ttl = _ttl;
+  entry->staleTime = _staleTime;
+}
+
+void UbiValueCache::invalidate(const char *device_label, const char *variable_label) {
+  CacheEntry *entry = _find(device_label, variable_label);
+  if (entry != NULL) {
+    entry->valid = false;
+  }
+}
+
+/**
+ * Gives the labels of a stale value that was served and has to be fetched
+ * again
+ * @return false if there is nothing to revalidate
+ */
+
+bool UbiValueCache::pendingRevalidation(const char **device_label, const char **variable_label) {
+  for (uint8_t i = 0; i < UBI_CACHE_SIZE; i++) {
+    if (_entries[i].valid && _entries[i].revalidate) {
+      _entries[i].revalidate = false;
+      *device_label = _entries[i].device_label;
+      *variable_label = _entries[i].variable_label;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************************************************************************
+ * Auxiliar
+ ***************************************************************************/
+
+UbiValueCache::CacheEntry *UbiValueCache::_find(const char *device_label, const char *variable_label) {
+  for (uint8_t i = 0; i < UBI_CACHE_SIZE; i++) {
+    if (_entries[i].valid && strcmp(_entries[i].device_label, device_label) == 0 &&
+        strcmp(_entries[i].variable_label, variable_label) == 0) {
+      return &_entries[i];
+    }
+  }
+  return NULL;
+}
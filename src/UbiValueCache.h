@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiValueCache_H_
+#define _UbiValueCache_H_
+
+#include "UbiConstants.h"
+
+typedef enum { UBI_CACHE_MISS, UBI_CACHE_FRESH, UBI_CACHE_STALE } UbiCacheStatus;
+
+/**
+ * Fixed-capacity cache of last values keyed by device/variable pair. Every
+ * entry keeps the TTL it was stored with. Once the TTL expires the value is
+ * still served during the stale time, while it waits to be revalidated.
+ */
+
+class UbiValueCache {
+public:
+  UbiValueCache();
+  void setTtl(unsigned long ttl, unsigned long staleTime);
+  bool enabled() const { return _ttl > 0; }
+  UbiCacheStatus lookup(const char *device_label, const char *variable_label, double *value);
+  void store(const char *device_label, const char *variable_label, double value);
+  void invalidate(const char *device_label, const char *variable_label);
+  bool pendingRevalidation(const char **device_label, const char **variable_label);
+  uint32_t hits() const { return _hits; }
+  uint32_t staleHits() const { return _staleHits; }
+  uint32_t misses() const { return _misses; }
+
+private:
+  typedef struct CacheEntry {
+    bool valid;
+    bool revalidate;
+    char device_label[UBI_CACHE_LABEL_SIZE];
+    char variable_label[UBI_CACHE_LABEL_SIZE];
+    double value;
+    unsigned long storedAt;
+    unsigned long ttl;
+    unsigned long staleTime;
+  } CacheEntry;
+
+  CacheEntry _entries[UBI_CACHE_SIZE];
+  unsigned long _ttl;
+  unsigned long _staleTime;
+  uint32_t _hits;
+  uint32_t _staleHits;
+  uint32_t _misses;
+
+  CacheEntry *_find(const char *device_label, const char *variable_label);
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#include "UbiValuesParser.h"
+
+#include "UbiUtils.h"
+
+/**************************************************************************
+ * Constructor
+ ***************************************************************************/
+
+UbiValuesParser::UbiValuesParser() { reset(); }
+
+void UbiValuesParser::reset() {
+  _results = 0;
+  _depth = 0;
+  _inString = false;
+  _escaped = false;
+  _haveString = false;
+  _stringHash = UbiUtils::FNV_OFFSET_BASIS;
+  _inResults = false;
+  _field = FIELD_NONE;
+  _numberLength = 0;
+  _readingNumber = false;
+  _contextLength = 0;
+  _contextDepth = 0;
+}
+
+/**************************************************************************
+ * Parser
+ ***************************************************************************/
+
+/**
+ * @arg c [Mandatory] next character of the page
+ * @return true when c closes a dot, which is then available in value()
+ */
+
+bool UbiValuesParser::feed(char c) {
+  if (_contextDepth > 0) {
+    _captureContext(c);
+    return false;
+  }
+  if (_inString) {
+    _string(c);
+    return false;
+  }
+  if (_readingNumber) {
+    if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+      if (_numberLength < UBI_HISTORY_NUMBER_SIZE - 1) {
+        _number[_numberLength++] = c;
+      }
+      return false;
+    }
+    _endNumber();
+  }
+
+  switch (c) {
+  case '"':
+    _inString = true;
+    _haveString = false;
+    _stringHash = UbiUtils::FNV_OFFSET_BASIS;
+    break;
+  case ':':
+    if (!_haveString) {
+      break;
+    }
+    if (_depth == 1) {
+      _inResults = _stringHash == UbiUtils::fnv1a("results");
+    } else if (_depth == 3 && _inResults) {
+      if (_stringHash == UbiUtils::fnv1a("value")) {
+        _field = FIELD_VALUE;
+      } else if (_stringHash == UbiUtils::fnv1a("timestamp")) {
+        _field = FIELD_TIMESTAMP;
+      } else if (_stringHash == UbiUtils::fnv1a("context")) {
+        _field = FIELD_CONTEXT;
+      }
+    }
+    _haveString = false;
+    break;
+  case '{':
+    if (_field == FIELD_CONTEXT) {
+      _field = FIELD_NONE;
+      _contextLength = 0;
+      _captureContext(c);
+      break;
+    }
+    _depth++;
+    if (_depth == 3 && _inResults) {
+      _value.value = 0;
+      _value.timestamp = 0;
+      _value.context[0] = '\0';
+    }
+    break;
+  case '[':
+    _depth++;
+    break;
+  case '}':
+    _depth--;
+    if (_depth == 2 && _inResults) {
+      _results++;
+      return true;
+    }
+    break;
+  case ']':
+    _depth--;
+    break;
+  case ',':
+    _field = FIELD_NONE;
+    _haveString = false;
+    break;
+  default:
+    if (_field == FIELD_VALUE || _field == FIELD_TIMESTAMP) {
+      if ((c >= '0' && c <= '9') || c == '-') {
+        _readingNumber = true;
+        _numberLength = 0;
+        _number[_numberLength++] = c;
+      }
+    }
+    break;
+  }
+  return false;
+}
+
+void UbiValuesParser::_string(char c) {
+  if (_escaped) {
+    _escaped = false;
+    _stringHash = UbiUtils::fnv1a(_stringHash, c);
+  } else if (c == '\\') {
+    _escaped = true;
+  } else if (c == '"') {
+    _inString = false;
+    _haveString = true;
+  } else {
+    _stringHash = UbiUtils::fnv1a(_stringHash, c);
+  }
+}
+
+/*
+ * Copies the context object as it is read, up to the size of the buffer. The
+ * braces inside its strings do not change its depth.
+ */
+
+void UbiValuesParser::_captureContext(char c) {
+  if (_contextLength < UBI_HISTORY_CONTEXT_SIZE - 1) {
+    _value.context[_contextLength++] = c;
+    _value.context[_contextLength] = '\0';
+  }
+  if (_inString) {
+    _string(c);
+  } else if (c == '"') {
+    _inString = true;
+  } else if (c == '{') {
+    _contextDepth++;
+  } else if (c == '}') {
+    _contextDepth--;
+  }
+}
+
+void UbiValuesParser::_endNumber() {
+  _readingNumber = false;
+  _number[_numberLength] = '\0';
+  if (_field == FIELD_VALUE) {
+    _value.value = strtod(_number, NULL);
+  } else if (_field == FIELD_TIMESTAMP) {
+    _value.timestamp = strtoull(_number, NULL, 10);
+  }
+  _field = FIELD_NONE;
+}
@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2013-2020 Ubidots.
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+Developed and maintained by Jose Garcia and Cristian Arrieta for IoT Services
+Inc
+@jotathebest at github: https://github.com/jotathebest
+@crisap94 at github: https://github.com/crisap94
+*/
+
+#ifndef _UbiValuesParser_H_
+#define _UbiValuesParser_H_
+
+#include <Arduino.h>
+
+#include "UbiConstants.h"
+
+typedef struct UbiHistoricalValue {
+  double value;
+  uint64_t timestamp;
+  // Raw JSON of the dot context, cut to the buffer size, empty if the dot has none
+  char context[UBI_HISTORY_CONTEXT_SIZE];
+} UbiHistoricalValue;
+
+/**
+ * Streaming parser of a page of the values endpoint:
+ * {"count":2,"next":null,"results":[{"timestamp":1,"value":2,"context":{}},...]}
+ * The page is fed one character at a time and every dot of "results" is
+ * reported as soon as its object is closed, so only one dot is held in RAM.
+ */
+
+class UbiValuesParser {
+public:
+  UbiValuesParser();
+  void reset();
+  bool feed(char c);
+  const UbiHistoricalValue &value() const { return _value; }
+  uint8_t results() const { return _results; }
+
+private:
+  typedef enum { FIELD_NONE, FIELD_VALUE, FIELD_TIMESTAMP, FIELD_CONTEXT } Field;
+
+  UbiHistoricalValue _value;
+  uint8_t _results;
+
+  int8_t _depth;
+  bool _inString;
+  bool _escaped;
+  bool _haveString;
+  uint32_t _stringHash;
+  bool _inResults;
+  Field _field;
+  char _number[UBI_HISTORY_NUMBER_SIZE];
+  uint8_t _numberLength;
+  bool _readingNumber;
+  uint8_t _contextLength;
+  int8_t _contextDepth;
+
+  void _string(char c);
+  void _captureContext(char c);
+  void _endNumber();
+};
+
+#endif
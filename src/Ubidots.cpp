@@ -36,10 +36,10 @@ Ubidots::Ubidots(const char *token, UbiServer server, IotProtocol iotProtocol) {
 void Ubidots::_builder(const char *token, UbiServer server, IotProtocol iotProtocol) {
   _getDeviceMac(_defaultDeviceLabel);
   _iotProtocol = iotProtocol;
-  _context = (ContextUbi *)malloc(MAX_VALUES * sizeof(ContextUbi));
   _deviceType = (char *)malloc(sizeof(char) * 25);
   _deviceType = NULL;
   _cloudProtocol = new UbiProtocolHandler(token, server, iotProtocol);
+  _cloudProtocol->setDebug(_debug);
 }
 
 /**************************************************************************
@@ -47,7 +47,6 @@ void Ubidots::_builder(const char *token, UbiServer server, IotProtocol iotProto
  ***************************************************************************/
 
 Ubidots::~Ubidots() {
-  free(_context);
   delete _cloudProtocol;
 }
 
@@ -64,6 +63,8 @@ FUNCTIONS TO SEND DATA
  * datalogger. Default NULL
  * @arg dot_timestamp_millis [optional] Dot timestamp in millis to add to
  * dot_timestamp_seconds, usefull for datalogger.
+ * Dots without timestamp are stamped with the current time once the clock is
+ * synced, see setAutoTimestamp().
  */
 
 void Ubidots::add(const char *variable_label, float value) { add(variable_label, value, NULL, NULL, NULL); }
@@ -81,6 +82,113 @@ void Ubidots::add(const char *variable_label, float value, char *context, long u
   _cloudProtocol->add(variable_label, value, context, dot_timestamp_seconds, dot_timestamp_millis);
 }
 
+/**
+ * Add a value of variable to save along with an UbiContext. The context is
+ * referenced by the dot, so it must be alive until send() is called, and it
+ * can be attached to as many dots as needed.
+ */
+
+void Ubidots::add(const char *variable_label, float value, const UbiContext &context) {
+  add(variable_label, value, context, 0, 0);
+}
+
+void Ubidots::add(const char *variable_label, float value, const UbiContext &context,
+                  unsigned long dot_timestamp_seconds) {
+  add(variable_label, value, context, dot_timestamp_seconds, 0);
+}
+
+void Ubidots::add(const char *variable_label, float value, const UbiContext &context,
+                  unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis) {
+  _cloudProtocol->add(variable_label, value, &context, dot_timestamp_seconds, dot_timestamp_millis);
+}
+
+/**
+ * Add a value of variable with a priority class. A high priority dot is sent
+ * at once together with the pending dots, low priority dots are sent when the
+ * bulk thresholds are reached. Dots are sent to the device set with
+ * setFlushDevice(), the device MAC by default.
+ * @arg priority [Mandatory] UBI_PRIORITY_HIGH, UBI_PRIORITY_NORMAL or
+ * UBI_PRIORITY_LOW
+ */
+
+void Ubidots::add(const char *variable_label, float value, UbiPriority priority) {
+  _cloudProtocol->add(variable_label, value, (char *)NULL, 0, 0, priority);
+  _flushIfDue();
+}
+
+void Ubidots::add(const char *variable_label, float value, const UbiContext &context, UbiPriority priority) {
+  _cloudProtocol->add(variable_label, value, &context, 0, 0, priority);
+  _flushIfDue();
+}
+
+/**
+ * Add a typed value of variable, written with all its digits in the payload.
+ * Integers go through integer formatting only, a fixed-point value is given
+ * as an integer with its number of decimals, e.g. 2315 with 2 decimals is
+ * sent as 23.15.
+ * @arg decimals [Mandatory] number of decimals of the fixed-point value, up
+ * to 18
+ */
+
+void Ubidots::addInt(const char *variable_label, int64_t value) {
+  _cloudProtocol->addInt(variable_label, value, NULL, 0, 0);
+}
+
+void Ubidots::addInt(const char *variable_label, int64_t value, unsigned long dot_timestamp_seconds,
+                     unsigned int dot_timestamp_millis) {
+  _cloudProtocol->addInt(variable_label, value, NULL, dot_timestamp_seconds, dot_timestamp_millis);
+}
+
+void Ubidots::addInt(const char *variable_label, int64_t value, const UbiContext &context,
+                     unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis) {
+  _cloudProtocol->addInt(variable_label, value, &context, dot_timestamp_seconds, dot_timestamp_millis);
+}
+
+void Ubidots::addFixed(const char *variable_label, int64_t value, uint8_t decimals) {
+  _cloudProtocol->addFixed(variable_label, value, decimals, NULL, 0, 0);
+}
+
+void Ubidots::addFixed(const char *variable_label, int64_t value, uint8_t decimals,
+                       unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis) {
+  _cloudProtocol->addFixed(variable_label, value, decimals, NULL, dot_timestamp_seconds, dot_timestamp_millis);
+}
+
+void Ubidots::addFixed(const char *variable_label, int64_t value, uint8_t decimals, const UbiContext &context,
+                       unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis) {
+  _cloudProtocol->addFixed(variable_label, value, decimals, &context, dot_timestamp_seconds, dot_timestamp_millis);
+}
+
+void Ubidots::addDouble(const char *variable_label, double value) {
+  _cloudProtocol->addDouble(variable_label, value, NULL, 0, 0);
+}
+
+void Ubidots::addDouble(const char *variable_label, double value, unsigned long dot_timestamp_seconds,
+                        unsigned int dot_timestamp_millis) {
+  _cloudProtocol->addDouble(variable_label, value, NULL, dot_timestamp_seconds, dot_timestamp_millis);
+}
+
+void Ubidots::addDouble(const char *variable_label, double value, const UbiContext &context,
+                        unsigned long dot_timestamp_seconds, unsigned int dot_timestamp_millis) {
+  _cloudProtocol->addDouble(variable_label, value, &context, dot_timestamp_seconds, dot_timestamp_millis);
+}
+
+/**
+ * Add a value that was queued with its type, e.g. read back from a log
+ * @arg context [Optional] UbiContext to attach to the dot, NULL for none
+ * @arg dot_timestamp [Optional] milliseconds since the epoch, 0 for none
+ */
+
+void Ubidots::addValue(const char *variable_label, const UbiTypedValue &value, const UbiContext *context,
+                       uint64_t dot_timestamp) {
+  _cloudProtocol->addValue(variable_label, value, context, dot_timestamp);
+}
+
+/**
+ * @return the dots waiting in the buffer for the next send()
+ */
+
+uint8_t Ubidots::pendingDots() { return _cloudProtocol->pendingDots(); }
+
 /**
  * Sends data to Ubidots
  * @arg device_label [Mandatory] device label where the dot will be stored
@@ -111,23 +219,187 @@ double Ubidots::get(const char *device_label, const char *variable_label) {
   return _cloudProtocol->get(device_label, variable_label);
 }
 
+/*
+ * Typed last values, integers and fixed-point values are read from the digits
+ * the server answers with, never through a double, so any int64_t is exact
+ * @arg value [Mandatory] Pointer to store the value
+ * @return false if the value could not be read
+ */
+
+bool Ubidots::getInt(const char *device_label, const char *variable_label, int64_t *value) {
+  return _cloudProtocol->getInt(device_label, variable_label, value);
+}
+
+bool Ubidots::getFixed(const char *device_label, const char *variable_label, uint8_t decimals, int64_t *value) {
+  return _cloudProtocol->getFixed(device_label, variable_label, decimals, value);
+}
+
+bool Ubidots::getDouble(const char *device_label, const char *variable_label, double *value) {
+  return _cloudProtocol->getDouble(device_label, variable_label, value);
+}
+
+/*
+ * Pipelined TCP requests: between beginPipeline() and endPipeline(), send()
+ * and getPipelined() write their frames on one socket without waiting for the
+ * server, and every answer is passed to the callback in queueing order
+ */
+
+bool Ubidots::beginPipeline(UbiPipelineCallback callback) { return _cloudProtocol->beginPipeline(callback); }
+
+bool Ubidots::getPipelined(const char *device_label, const char *variable_label) {
+  return _cloudProtocol->getPipelined(device_label, variable_label);
+}
+
+uint8_t Ubidots::pollPipeline() { return _cloudProtocol->pollPipeline(); }
+
+uint8_t Ubidots::pipelineSlots() { return _cloudProtocol->pipelineSlots(); }
+
+bool Ubidots::pipelined() { return _cloudProtocol->pipelined(); }
+
+bool Ubidots::endPipeline() { return _cloudProtocol->endPipeline(); }
+
+/*
+ * Historical values: getValues() requests the values of a variable, newest
+ * first, and nextValue() returns them one at a time while it reads the pages
+ * from the server, so they are never held in RAM at once. Other HTTP requests
+ * fail until every value was read or endValues() is called.
+ */
+
+bool Ubidots::getValues(const char *device_label, const char *variable_label, uint16_t count, uint64_t start,
+                        uint64_t end) {
+  return _cloudProtocol->beginValues(device_label, variable_label, count, start, end);
+}
+
+bool Ubidots::nextValue(UbiHistoricalValue *value) { return _cloudProtocol->nextValue(value); }
+
+void Ubidots::endValues() { _cloudProtocol->endValues(); }
+
+/*
+ * MQTT subscriptions: the callback gets every new dot of the variable. loop()
+ * must be called often to keep the session alive and receive the values.
+ */
+
+bool Ubidots::subscribe(const char *device_label, const char *variable_label, UbiSubscribeCallback callback) {
+  return _cloudProtocol->subscribe(device_label, variable_label, callback);
+}
+
+bool Ubidots::loop() {
+  _flushIfDue();
+  return _cloudProtocol->loop();
+}
+
+void Ubidots::setQos(uint8_t qos) { _cloudProtocol->setQos(qos); }
+
+/*
+ * Last value cache: get() reuses a value fetched less than ttl ms ago for the
+ * same device and variable, and during stale_time ms more while loop()
+ * fetches it again. Sending a dot to the variable invalidates its value.
+ */
+
+void Ubidots::setCacheTtl(unsigned long ttl, unsigned long stale_time) { _cloudProtocol->setCacheTtl(ttl, stale_time); }
+
+uint32_t Ubidots::cacheHits() { return _cloudProtocol->cache().hits(); }
+
+uint32_t Ubidots::cacheStaleHits() { return _cloudProtocol->cache().staleHits(); }
+
+uint32_t Ubidots::cacheMisses() { return _cloudProtocol->cache().misses(); }
+
+/*
+ * Retries for batches that fail or whose answer is lost. Dots added without
+ * timestamp are stamped by the first send() that takes them, with the time
+ * they were added at, so a retried batch does not duplicate them.
+ */
+
+void Ubidots::setRetryPolicy(uint8_t max_retries, unsigned long retry_budget) {
+  _cloudProtocol->setRetryPolicy(max_retries, retry_budget);
+}
+
+uint32_t Ubidots::lastBatchId() { return _cloudProtocol->lastBatchId(); }
+
+/*
+ * Dots added without timestamp are stamped with the library clock, synced from
+ * NTP through the WiFi module or from the HTTP Date header
+ */
+
+void Ubidots::setAutoTimestamp(bool auto_timestamp) { _cloudProtocol->setAutoTimestamp(auto_timestamp); }
+
+uint64_t Ubidots::now() { return _cloudProtocol->clock().now(); }
+
+/*
+ * Priority classes: the dots added with a priority are sent to the flush
+ * device without an explicit send(). loop() sends the low priority dots that
+ * reached the age threshold. Latencies from add() to the server answer are
+ * kept per class.
+ */
+
+void Ubidots::setFlushDevice(const char *device_label) { _flushDeviceLabel = device_label; }
+
+void Ubidots::setBulkThresholds(uint8_t max_dots, unsigned long max_age, uint16_t max_bytes) {
+  _cloudProtocol->setBulkThresholds(max_dots, max_age, max_bytes);
+}
+
+const UbiLatencyStats &Ubidots::latencyStats(UbiPriority priority) { return _cloudProtocol->latencyStats(priority); }
+
+/*
+ * Binary trace of the sends and requests, drained to the output from loop()
+ */
+
+bool Ubidots::setTrace(Print *output) { return _cloudProtocol->setTrace(output); }
+
+uint32_t Ubidots::traceDropped() { return _cloudProtocol->trace().dropped(); }
+
+/*
+ * Failover mode: send() and get() go through the healthiest of the transports
+ * added, the one set in the constructor included, and fail over to the next
+ * one when it fails. transportHealth() is the recent success rate in percent.
+ */
+
+bool Ubidots::addFailover(IotProtocol iot_protocol) { return _cloudProtocol->addFailover(iot_protocol); }
+
+IotProtocol Ubidots::lastTransport() { return _cloudProtocol->lastTransport(); }
+
+uint8_t Ubidots::transportHealth(IotProtocol iot_protocol) {
+  return _cloudProtocol->failover().successRate(iot_protocol);
+}
+
+/*
+ * Connections shared between instances, e.g. a gateway with several tokens
+ */
+
+void Ubidots::setConnectionPool(UbiConnectionPool *pool) { _cloudProtocol->setConnectionPool(pool); }
+
+/*
+ * Client side rate limits; while one is reached send() keeps the dots for the
+ * next batch. Retry-After answers of the server are honoured in any case.
+ */
+
+void Ubidots::setRateLimit(uint16_t requests_per_minute, uint16_t request_burst, uint16_t dots_per_second,
+                           uint16_t dot_burst) {
+  _cloudProtocol->setRateLimit(requests_per_minute, request_burst, dots_per_second, dot_burst);
+}
+
+uint32_t Ubidots::throttled() { return _cloudProtocol->rateLimiter().throttled(); }
+
+void Ubidots::_flushIfDue() {
+  if (_cloudProtocol->flushDue()) {
+    send(_flushDeviceLabel);
+  }
+}
+
 void Ubidots::setDebug(bool debug) {
   _debug = debug;
   _cloudProtocol->setDebug(debug);
 }
 
 /*
- * Adds to the context structure values to retrieve later it easily by the user
+ * Adds to the context structure values to retrieve later it easily by the user.
+ * Both strings are copied, prefer an UbiContext instance for new sketches.
  */
 
-void Ubidots::addContext(char *key_label, char *key_value) {
-  (_context + _current_context)->key_label = key_label;
-  (_context + _current_context)->key_value = key_value;
-  _current_context++;
-  if (_current_context >= MAX_VALUES) {
+void Ubidots::addContext(const char *key_label, const char *key_value) {
+  if (!_context.add(key_label, key_value) && UBI_LOG_ERROR) {
     Serial.println(F("You are adding more than the maximum of consecutive "
-                     "key-values pairs"));
-    _current_context = MAX_VALUES;
+                     "key-values pairs, or a pair with characters the payload can not carry"));
   }
 }
 
@@ -135,43 +407,35 @@ void Ubidots::addContext(char *key_label, char *key_value) {
  * Retrieves the actual stored context properly formatted
  */
 
-void Ubidots::getContext(char *context_result) { getContext(context_result, _iotProtocol); }
+void Ubidots::getContext(char *context_result, size_t size) { getContext(context_result, size, _iotProtocol); }
 
-void Ubidots::getContext(char *context_result, IotProtocol iotProtocol) {
-  // TCP context type
-  if (iotProtocol == UBI_TCP || iotProtocol == UBI_UDP) {
-    sprintf(context_result, "");
-    for (uint8_t i = 0; i < _current_context;) {
-      sprintf(context_result, "%s%s=%s", context_result, (_context + i)->key_label, (_context + i)->key_value);
-      i++;
-      if (i < _current_context) {
-        sprintf(context_result, "%s$", context_result);
-      } else {
-        sprintf(context_result, "%s", context_result);
-        _current_context = 0;
-      }
-    }
-  }
+/**
+ * @arg size [Mandatory] size of context_result, an empty context is returned
+ * if the whole context does not fit
+ */
 
-  // HTTP context type
-  if (iotProtocol == UBI_HTTP) {
-    sprintf(context_result, "");
-    for (uint8_t i = 0; i < _current_context;) {
-      sprintf(context_result, "%s\"%s\":\"%s\"", context_result, (_context + i)->key_label, (_context + i)->key_value);
-      i++;
-      if (i < _current_context) {
-        sprintf(context_result, "%s,", context_result);
-      } else {
-        sprintf(context_result, "%s", context_result);
-        _current_context = 0;
-      }
-    }
+void Ubidots::getContext(char *context_result, size_t size, IotProtocol iotProtocol) {
+  if (_context.encode(context_result, size, iotProtocol) == 0 && _context.size() > 0 && UBI_LOG_ERROR) {
+    Serial.println(F("[ERROR] The context does not fit in the buffer given to getContext()"));
   }
+  _context.clear();
+}
+
+/**
+ * Deprecated, the buffer is taken as UBI_CONTEXT_ENCODED_SIZE bytes long
+ */
+
+void Ubidots::getContext(char *context_result) {
+  getContext(context_result, UBI_CONTEXT_ENCODED_SIZE, _iotProtocol);
+}
+
+void Ubidots::getContext(char *context_result, IotProtocol iotProtocol) {
+  getContext(context_result, UBI_CONTEXT_ENCODED_SIZE, iotProtocol);
 }
 
 bool Ubidots::wifiConnect(const char *ssid, const char *password) {
   uint8_t maxConnectionAttempts = 0;
-  if (_debug) {
+  if (UBI_LOG_INFO) {
     Serial.println(F("Connecting to WiFi"));
   }
 
@@ -179,21 +443,29 @@ bool Ubidots::wifiConnect(const char *ssid, const char *password) {
 
   while (WiFi.status() != WL_CONNECTED && maxConnectionAttempts < _maxConnectionAttempts) {
     delay(500);
-    Serial.print(".");
+    if (UBI_LOG_INFO) {
+      Serial.print(F("."));
+    }
     maxConnectionAttempts++;
   }
   if (WiFi.status() == WL_NO_SSID_AVAIL) {
-    Serial.println("Your network SSID cannot be reached");
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("Your network SSID cannot be reached"));
+    }
     return false;
   }
   if (WiFi.status() == WL_CONNECT_FAILED) {
-    Serial.println("Network password incorrect");
+    if (UBI_LOG_ERROR) {
+      Serial.println(F("Network password incorrect"));
+    }
     return false;
   }
 
-  Serial.println(F("WiFi connected"));
-  Serial.println(F("IP address: "));
-  Serial.println(WiFi.localIP());
+  if (UBI_LOG_INFO) {
+    Serial.println(F("WiFi connected"));
+    Serial.println(F("IP address: "));
+    Serial.println(WiFi.localIP());
+  }
   return true;
 }
 bool Ubidots::wifiConnected() { return WiFi.status() == WL_CONNECTED; }
@@ -204,8 +476,8 @@ void Ubidots::_getDeviceMac(char *macAddr) {
   byte mac[6];
   WiFi.macAddress(mac);
   sprintf(macAddr, "%02X:%02X:%02X:%02X:%02X:%02X", mac[5], mac[4], mac[3], mac[2], mac[1], mac[0]);
-  if (_debug) {
-    Serial.print("MAC: ");
+  if (UBI_LOG_INFO) {
+    Serial.print(F("MAC: "));
     Serial.println(macAddr);
   }
   sprintf(_defaultDeviceLabel, macAddr);
@@ -217,7 +489,7 @@ void Ubidots::_getDeviceMac(char *macAddr) {
 void Ubidots::setDeviceType(const char *deviceType) {
   if (strlen(deviceType) > 0 && _iotProtocol == UBI_HTTP) {
     sprintf(_deviceType, "%s", deviceType);
-  } else {
-    Serial.println("Device Type is only available using HTTP");
+  } else if (UBI_LOG_ERROR) {
+    Serial.println(F("Device Type is only available using HTTP"));
   }
 }
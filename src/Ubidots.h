@@ -37,13 +37,76 @@ public:
   void add(const char *variable_label, float value, char *context, unsigned long dot_timestamp_seconds);
   void add(const char *variable_label, float value, char *context, unsigned long dot_timestamp_seconds,
            unsigned int dot_timestamp_millis);
-  void addContext(char *key_label, char *key_value);
-  void getContext(char *context_result);
-  void getContext(char *context_result, IotProtocol iotProtocol);
+  void add(const char *variable_label, float value, const UbiContext &context);
+  void add(const char *variable_label, float value, const UbiContext &context, unsigned long dot_timestamp_seconds);
+  void add(const char *variable_label, float value, const UbiContext &context, unsigned long dot_timestamp_seconds,
+           unsigned int dot_timestamp_millis);
+  void add(const char *variable_label, float value, UbiPriority priority);
+  void add(const char *variable_label, float value, const UbiContext &context, UbiPriority priority);
+  void addInt(const char *variable_label, int64_t value);
+  void addInt(const char *variable_label, int64_t value, unsigned long dot_timestamp_seconds,
+              unsigned int dot_timestamp_millis = 0);
+  void addInt(const char *variable_label, int64_t value, const UbiContext &context,
+              unsigned long dot_timestamp_seconds = 0, unsigned int dot_timestamp_millis = 0);
+  void addFixed(const char *variable_label, int64_t value, uint8_t decimals);
+  void addFixed(const char *variable_label, int64_t value, uint8_t decimals, unsigned long dot_timestamp_seconds,
+                unsigned int dot_timestamp_millis = 0);
+  void addFixed(const char *variable_label, int64_t value, uint8_t decimals, const UbiContext &context,
+                unsigned long dot_timestamp_seconds = 0, unsigned int dot_timestamp_millis = 0);
+  void addDouble(const char *variable_label, double value);
+  void addDouble(const char *variable_label, double value, unsigned long dot_timestamp_seconds,
+                 unsigned int dot_timestamp_millis = 0);
+  void addDouble(const char *variable_label, double value, const UbiContext &context,
+                 unsigned long dot_timestamp_seconds = 0, unsigned int dot_timestamp_millis = 0);
+  void addValue(const char *variable_label, const UbiTypedValue &value, const UbiContext *context = NULL,
+                uint64_t dot_timestamp = 0);
+  uint8_t pendingDots();
+  void addContext(const char *key_label, const char *key_value);
+  void getContext(char *context_result, size_t size);
+  void getContext(char *context_result, size_t size, IotProtocol iotProtocol);
+  void getContext(char *context_result) __attribute__((deprecated("pass the size of the buffer")));
+  void getContext(char *context_result, IotProtocol iotProtocol)
+      __attribute__((deprecated("pass the size of the buffer")));
   bool send();
   bool send(const char *device_label);
   bool send(const char *device_label, const char *device_name);
   double get(const char *device_label, const char *variable_label);
+  bool getInt(const char *device_label, const char *variable_label, int64_t *value);
+  bool getFixed(const char *device_label, const char *variable_label, uint8_t decimals, int64_t *value);
+  bool getDouble(const char *device_label, const char *variable_label, double *value);
+  bool beginPipeline(UbiPipelineCallback callback);
+  bool getPipelined(const char *device_label, const char *variable_label);
+  uint8_t pollPipeline();
+  uint8_t pipelineSlots();
+  bool pipelined();
+  bool endPipeline();
+  bool getValues(const char *device_label, const char *variable_label, uint16_t count, uint64_t start = 0,
+                 uint64_t end = 0);
+  bool nextValue(UbiHistoricalValue *value);
+  void endValues();
+  bool subscribe(const char *device_label, const char *variable_label, UbiSubscribeCallback callback);
+  bool loop();
+  void setQos(uint8_t qos);
+  void setCacheTtl(unsigned long ttl, unsigned long stale_time = 0);
+  uint32_t cacheHits();
+  uint32_t cacheStaleHits();
+  uint32_t cacheMisses();
+  void setRetryPolicy(uint8_t max_retries, unsigned long retry_budget);
+  uint32_t lastBatchId();
+  void setAutoTimestamp(bool auto_timestamp);
+  uint64_t now();
+  void setFlushDevice(const char *device_label);
+  void setBulkThresholds(uint8_t max_dots, unsigned long max_age, uint16_t max_bytes);
+  const UbiLatencyStats &latencyStats(UbiPriority priority);
+  bool setTrace(Print *output);
+  uint32_t traceDropped();
+  bool addFailover(IotProtocol iot_protocol);
+  IotProtocol lastTransport();
+  uint8_t transportHealth(IotProtocol iot_protocol);
+  void setConnectionPool(UbiConnectionPool *pool);
+  void setRateLimit(uint16_t requests_per_minute, uint16_t request_burst, uint16_t dots_per_second = 0,
+                    uint16_t dot_burst = 0);
+  uint32_t throttled();
   void setDebug(bool debug);
   bool wifiConnect(const char *ssid, const char *password);
   bool wifiConnected();
@@ -52,19 +115,20 @@ public:
   ~Ubidots();
 
 private:
-  bool _debug = true;
-  int8_t _current_context = 0;
+  bool _debug = UBI_DEBUG_DEFAULT;
   uint8_t _maxConnectionAttempts = 20;
 
   char *_deviceType;
   char _defaultDeviceLabel[18] = {0};
+  const char *_flushDeviceLabel = _defaultDeviceLabel;
 
   UbiProtocolHandler *_cloudProtocol;
-  ContextUbi *_context;
+  UbiContext _context;
   IotProtocol _iotProtocol;
 
   void _builder(const char *token, UbiServer server, IotProtocol iot_protocol);
   void _getDeviceMac(char macAddr[]);
+  void _flushIfDue();
 };
 
 #endif